@@ -0,0 +1,518 @@
+/*
+ * capture.c - Record the malloc traffic of a program for mdriver
+ *
+ * Built as libmmcapture.so, preloaded into a program:
+ *
+ *     MMCAPTURE_FILE=app.log LD_PRELOAD=./libmmcapture.so app
+ *
+ * every malloc, calloc, realloc, free, memalign, aligned_alloc and
+ * posix_memalign of the program becomes a record of the capture log
+ * (trace.h). A %p in MMCAPTURE_FILE stands for the process id, which
+ * keeps the programs that app runs from overwriting its log; the
+ * default is mmcapture.%p.log. Blocks get ids in the
+ * order they are allocated and keep them across reallocs. mdriver reads
+ * a capture log like a trace, and converts it to a binary one with
+ *
+ *     mdriver -f app.log -c app.bin
+ *
+ * Each thread logs into a buffer of its own, written out when it is
+ * full, at thread exit and at program exit; the records carry sequence
+ * numbers, by which mdriver puts them back in order. The blocks are
+ * found by address in a hash table split into separately locked stripes.
+ * Requests for 0 bytes are recorded as requests for 1, which mdriver can
+ * replay. A child process does not record anything, and the records of
+ * threads still running at exit, or lost to a crash, are missing.
+ */
+#define _GNU_SOURCE /* RTLD_NEXT */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <dlfcn.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "trace.h"
+
+#define LOG_RECS     8192  /* records per thread buffer */
+#define STRIPES        64  /* separately locked parts of the block table */
+#define BUCKETS     16384  /* hash buckets per stripe */
+#define NODE_CHUNK   4096  /* block records mapped at a time */
+#define BOOT_SIZE   65536  /* serves allocations while libc is looked up */
+
+/* Capturing states */
+#define OFF       0        /* not yet, or no longer */
+#define STARTING  1        /* looking up libc's functions */
+#define ON        2
+
+/* A block of the captured program */
+typedef struct node_t {
+    uintptr_t p;           /* its address */
+    uint32_t id;           /* ... its trace id */
+    uint64_t size;         /* ... and its size, for the free record */
+    struct node_t *next;   /* next in the bucket, or in the pool */
+} node_t;
+
+/* A part of the block table, with a lock of its own */
+typedef struct {
+    pthread_mutex_t lock;
+    node_t *buckets[BUCKETS];
+    node_t *pool;          /* unused block records */
+} stripe_t;
+
+/* The records of one thread not yet written to the log */
+typedef struct logbuf_t {
+    capture_rec_t recs[LOG_RECS];
+    int n;
+    struct logbuf_t *next; /* next in use, or next unused */
+} logbuf_t;
+
+/* libc's functions */
+static void *(*real_malloc)(size_t);
+static void *(*real_calloc)(size_t, size_t);
+static void *(*real_realloc)(void *, size_t);
+static void (*real_free)(void *);
+static void *(*real_memalign)(size_t, size_t);
+static void *(*real_aligned_alloc)(size_t, size_t);
+static int (*real_posix_memalign)(void **, size_t, size_t);
+
+static int state = OFF;
+static pthread_once_t once = PTHREAD_ONCE_INIT;
+static int log_fd = -1;
+static uint64_t next_seq = 0;          /* sequence number of the next record */
+static uint32_t next_id = 0;           /* id of the next block */
+static stripe_t stripes[STRIPES];
+
+/* The thread buffers: those in use for the flush at exit, and unused ones
+   of finished threads */
+static logbuf_t *bufs = NULL;
+static logbuf_t *free_bufs = NULL;
+static pthread_mutex_t bufs_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t buf_key;
+#define TLS __thread __attribute__((tls_model("initial-exec"))) /* no malloc */
+static TLS logbuf_t *buf = NULL;
+static TLS int busy = 0;               /* in our own code: don't capture */
+
+/* Allocations before real_malloc is known, each behind its size */
+static char boot[BOOT_SIZE] __attribute__((aligned(16)));
+static size_t boot_used = 0;
+
+static void start(void);
+static void finish(void) __attribute__((destructor));
+static void stop_child(void);
+static int passthrough(void);
+static void *boot_alloc(size_t size);
+static int is_boot(void *p);
+static void record_alloc(void *p, size_t size, size_t align);
+static void log_op(uint64_t seq, int type, uint32_t id, uint64_t size,
+		   uint64_t align);
+static void flush_buf(logbuf_t *b);
+static void thread_done(void *ptr);
+static stripe_t *stripe_of(uintptr_t p);
+static node_t **bucket_of(stripe_t *s, uintptr_t p);
+static void insert_block(uintptr_t p, uint32_t id, uint64_t size);
+static int remove_block(uintptr_t p, uint32_t *id, uint64_t *size);
+
+/*******************************************
+ * The interposed functions of the C library
+ *******************************************/
+
+void *malloc(size_t size)
+{
+    void *p;
+
+    if (passthrough())
+	return real_malloc ? real_malloc(size) : boot_alloc(size);
+    if ((p = real_malloc(size)) != NULL)
+	record_alloc(p, size, 0);
+    return p;
+}
+
+void *calloc(size_t n, size_t size)
+{
+    void *p;
+
+    if (passthrough()) {
+	if (real_calloc)
+	    return real_calloc(n, size);
+	if (size && n > SIZE_MAX / size)
+	    return NULL;
+	return boot_alloc(n * size); /* boot is zeroed */
+    }
+    if ((p = real_calloc(n, size)) != NULL)
+	record_alloc(p, n * size, 0);
+    return p;
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    void *p;
+    uint32_t id;
+    uint64_t oldsize;
+    int found;
+
+    if (ptr && is_boot(ptr)) { /* move it out of boot */
+	if ((p = malloc(size)) != NULL) {
+	    oldsize = ((size_t *)ptr)[-2];
+	    memcpy(p, ptr, oldsize < size ? oldsize : size);
+	}
+	return p;
+    }
+    if (passthrough())
+	return real_realloc ? real_realloc(ptr, size) : boot_alloc(size);
+    if (ptr == NULL)
+	return malloc(size);
+    if (size == 0) { /* frees ptr */
+	free(ptr);
+	return NULL;
+    }
+
+    /* Take the block out of the table before libc can hand its address
+       to another thread */
+    found = remove_block((uintptr_t)ptr, &id, &oldsize);
+    if ((p = real_realloc(ptr, size)) == NULL) {
+	if (found)
+	    insert_block((uintptr_t)ptr, id, oldsize);
+	return NULL;
+    }
+    if (found) {
+	insert_block((uintptr_t)p, id, size);
+	log_op(__atomic_fetch_add(&next_seq, 1, __ATOMIC_RELAXED),
+	       TRACE_REALLOC, id, size, 0);
+    }
+    else
+	record_alloc(p, size, 0);
+    return p;
+}
+
+void free(void *ptr)
+{
+    uint32_t id;
+    uint64_t size;
+
+    if (ptr == NULL || is_boot(ptr))
+	return;
+    if (!passthrough() && remove_block((uintptr_t)ptr, &id, &size))
+	log_op(__atomic_fetch_add(&next_seq, 1, __ATOMIC_RELAXED),
+	       TRACE_FREE, id, size, 0);
+    if (real_free) /* else leak it, while start looks up libc */
+	real_free(ptr);
+}
+
+void *memalign(size_t align, size_t size)
+{
+    void *p;
+
+    if (passthrough())
+	return real_memalign ? real_memalign(align, size) : NULL;
+    if ((p = real_memalign(align, size)) != NULL)
+	record_alloc(p, size, align);
+    return p;
+}
+
+void *aligned_alloc(size_t align, size_t size)
+{
+    void *p;
+
+    if (passthrough())
+	return real_aligned_alloc ? real_aligned_alloc(align, size) : NULL;
+    if ((p = real_aligned_alloc(align, size)) != NULL)
+	record_alloc(p, size, align);
+    return p;
+}
+
+int posix_memalign(void **ptr, size_t align, size_t size)
+{
+    int err;
+
+    if (passthrough())
+	return real_posix_memalign ? real_posix_memalign(ptr, align, size) : ENOMEM;
+    if ((err = real_posix_memalign(ptr, align, size)) == 0)
+	record_alloc(*ptr, size, align);
+    return err;
+}
+
+/*****************
+ * Helper routines
+ *****************/
+
+/*
+ * start - Look up libc's functions and open the log
+ */
+static void start(void)
+{
+    char path[PATH_MAX];
+    const char *name, *pid;
+    int i;
+
+    state = STARTING;
+    real_free = dlsym(RTLD_NEXT, "free");
+    real_malloc = dlsym(RTLD_NEXT, "malloc");
+    real_calloc = dlsym(RTLD_NEXT, "calloc");
+    real_realloc = dlsym(RTLD_NEXT, "realloc");
+    real_memalign = dlsym(RTLD_NEXT, "memalign");
+    real_aligned_alloc = dlsym(RTLD_NEXT, "aligned_alloc");
+    real_posix_memalign = dlsym(RTLD_NEXT, "posix_memalign");
+
+    if ((name = getenv("MMCAPTURE_FILE")) == NULL)
+	name = "mmcapture.%p.log";
+    if ((pid = strstr(name, "%p")) != NULL)
+	snprintf(path, sizeof(path), "%.*s%d%s",
+		 (int)(pid - name), name, (int)getpid(), pid + 2);
+    else
+	snprintf(path, sizeof(path), "%s", name);
+    log_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (log_fd < 0 || write(log_fd, CAPTURE_MAGIC, 8) != 8) {
+	fprintf(stderr, "mmcapture: cannot write %s, not capturing\n", path);
+	state = OFF;
+	return;
+    }
+    for (i = 0; i < STRIPES; i++)
+	pthread_mutex_init(&stripes[i].lock, NULL);
+    pthread_key_create(&buf_key, thread_done);
+    pthread_atfork(NULL, NULL, stop_child);
+    state = ON;
+}
+
+/*
+ * finish - At exit, write the records of all threads to the log
+ */
+static void finish(void)
+{
+    logbuf_t *b;
+
+    if (state != ON)
+	return;
+    state = OFF;
+    pthread_mutex_lock(&bufs_lock);
+    for (b = bufs; b; b = b->next)
+	flush_buf(b);
+    pthread_mutex_unlock(&bufs_lock);
+    close(log_fd);
+}
+
+/*
+ * stop_child - A child process inherits the log and the buffers, but
+ *     must not add to them
+ */
+static void stop_child(void)
+{
+    state = OFF;
+}
+
+/*
+ * passthrough - Does this call go straight to libc? It does while
+ *     capturing is off and for calls made by our own code.
+ */
+static int passthrough(void)
+{
+    if (busy)
+	return 1;
+    if (state == OFF && real_malloc == NULL) {
+	busy = 1;
+	pthread_once(&once, start);
+	busy = 0;
+    }
+    return state != ON;
+}
+
+/*
+ * boot_alloc - Allocate from boot, for dlsym while start looks up libc
+ */
+static void *boot_alloc(size_t size)
+{
+    size_t *p;
+    size_t need = 2 * sizeof(size_t) + ((size + 15) & ~(size_t)15);
+
+    if (size > BOOT_SIZE ||
+	__atomic_load_n(&boot_used, __ATOMIC_RELAXED) + need > BOOT_SIZE)
+	return NULL;
+    p = (size_t *)(boot + __atomic_fetch_add(&boot_used, need, __ATOMIC_RELAXED));
+    if ((char *)p + need > boot + BOOT_SIZE)
+	return NULL;
+    p[0] = size;
+    return p + 2;
+}
+
+/*
+ * is_boot - Was p allocated by boot_alloc?
+ */
+static int is_boot(void *p)
+{
+    return (char *)p >= boot && (char *)p < boot + BOOT_SIZE;
+}
+
+/*
+ * record_alloc - Give the new block p an id and log its allocation
+ */
+static void record_alloc(void *p, size_t size, size_t align)
+{
+    uint32_t id = __atomic_fetch_add(&next_id, 1, __ATOMIC_RELAXED);
+
+    if (size == 0)
+	size = 1;
+    if (align & (align - 1)) /* mdriver only replays powers of two */
+	align = 0;
+    insert_block((uintptr_t)p, id, size);
+    log_op(__atomic_fetch_add(&next_seq, 1, __ATOMIC_RELAXED),
+	   TRACE_ALLOC, id, size, align);
+}
+
+/*
+ * log_op - Add a record to the buffer of this thread, and write the
+ *     buffer to the log when it is full
+ */
+static void log_op(uint64_t seq, int type, uint32_t id, uint64_t size,
+		   uint64_t align)
+{
+    logbuf_t *b = buf;
+    capture_rec_t *r;
+
+    if (b == NULL) {
+	busy = 1; /* pthread_setspecific may allocate */
+	pthread_mutex_lock(&bufs_lock);
+	if ((b = free_bufs) != NULL)
+	    free_bufs = b->next;
+	pthread_mutex_unlock(&bufs_lock);
+	if (b == NULL) {
+	    b = mmap(NULL, sizeof(logbuf_t), PROT_READ | PROT_WRITE,
+		     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	    if (b == MAP_FAILED) {
+		busy = 0;
+		return;
+	    }
+	}
+	b->n = 0;
+	pthread_mutex_lock(&bufs_lock);
+	b->next = bufs;
+	bufs = b;
+	pthread_mutex_unlock(&bufs_lock);
+	buf = b;
+	pthread_setspecific(buf_key, b);
+	busy = 0;
+    }
+
+    r = &b->recs[b->n];
+    r->seq = seq;
+    r->rec.type = type;
+    r->rec.index = id;
+    r->rec.size = size;
+    r->rec.align = align;
+    if (++b->n == LOG_RECS) {
+	pthread_mutex_lock(&bufs_lock);
+	flush_buf(b);
+	pthread_mutex_unlock(&bufs_lock);
+    }
+}
+
+/*
+ * flush_buf - Write the records of a buffer to the log, with bufs_lock
+ *     held so the writes of two threads don't interleave
+ */
+static void flush_buf(logbuf_t *b)
+{
+    char *p = (char *)b->recs;
+    size_t left = b->n * sizeof(capture_rec_t);
+    ssize_t n;
+
+    while (left > 0 && (n = write(log_fd, p, left)) > 0) {
+	p += n;
+	left -= n;
+    }
+    b->n = 0;
+}
+
+/*
+ * thread_done - At thread exit, write the records of its buffer to the
+ *     log and keep the buffer for another thread
+ */
+static void thread_done(void *ptr)
+{
+    logbuf_t *b = (logbuf_t *)ptr, **pp;
+
+    pthread_mutex_lock(&bufs_lock);
+    if (state == ON)
+	flush_buf(b);
+    for (pp = &bufs; *pp; pp = &(*pp)->next)
+	if (*pp == b) {
+	    *pp = b->next;
+	    break;
+	}
+    b->next = free_bufs;
+    free_bufs = b;
+    pthread_mutex_unlock(&bufs_lock);
+    buf = NULL;
+}
+
+/*
+ * stripe_of, bucket_of - Where the table keeps the block at p
+ */
+static stripe_t *stripe_of(uintptr_t p)
+{
+    return &stripes[((p >> 4) * 0x9E3779B97F4A7C15ULL) >> 58];
+}
+
+static node_t **bucket_of(stripe_t *s, uintptr_t p)
+{
+    return &s->buckets[(((p >> 4) * 0xC2B2AE3D27D4EB4FULL) >> 32) % BUCKETS];
+}
+
+/*
+ * insert_block - Enter the block at p into the table
+ */
+static void insert_block(uintptr_t p, uint32_t id, uint64_t size)
+{
+    stripe_t *s = stripe_of(p);
+    node_t *n, **b;
+    int i;
+
+    pthread_mutex_lock(&s->lock);
+    if (s->pool == NULL) {
+	n = mmap(NULL, NODE_CHUNK * sizeof(node_t), PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (n == MAP_FAILED) {
+	    pthread_mutex_unlock(&s->lock);
+	    return;
+	}
+	for (i = 0; i < NODE_CHUNK; i++) {
+	    n[i].next = s->pool;
+	    s->pool = &n[i];
+	}
+    }
+    n = s->pool;
+    s->pool = n->next;
+    n->p = p;
+    n->id = id;
+    n->size = size;
+    b = bucket_of(s, p);
+    n->next = *b;
+    *b = n;
+    pthread_mutex_unlock(&s->lock);
+}
+
+/*
+ * remove_block - Take the block at p out of the table; return 0 if it is
+ *     not there (allocated before the capture started)
+ */
+static int remove_block(uintptr_t p, uint32_t *id, uint64_t *size)
+{
+    stripe_t *s = stripe_of(p);
+    node_t *n, **pp;
+
+    pthread_mutex_lock(&s->lock);
+    for (pp = bucket_of(s, p); (n = *pp) != NULL; pp = &n->next)
+	if (n->p == p) {
+	    *pp = n->next;
+	    *id = n->id;
+	    *size = n->size;
+	    n->next = s->pool;
+	    s->pool = n;
+	    break;
+	}
+    pthread_mutex_unlock(&s->lock);
+    return n != NULL;
+}
@@ -34,6 +34,15 @@
   "binary-bal.rep",\
   "binary2-bal.rep"
 
+/*
+ * Traces of mm_realloc, added to the default ones with mdriver -e. They
+ * are left out of the default set so that the performance index stays
+ * comparable with packages graded without realloc.
+ */
+#define REALLOC_TRACEFILES \
+  "realloc-bal.rep",\
+  "realloc2-bal.rep"
+
 /*
  * This constant gives the estimated performance of the libc malloc
  * package using our traces on some reference system, typically the
@@ -45,6 +54,19 @@
  */
 #define AVG_LIBC_THRUPUT      5000E3  /* 5000 Kops/sec */
 
+/*
+ * Timing (fsecs.c): every trace is run FSECS_WARMUP times untimed, then
+ * timed in samples of at least FSECS_MIN_SAMPLE seconds until the
+ * FSECS_K fastest samples agree within FSECS_EPSILON, but at least
+ * FSECS_MIN_SAMPLES (>= FSECS_K) and at most FSECS_MAX_SAMPLES times.
+ */
+#define FSECS_WARMUP       2
+#define FSECS_MIN_SAMPLE   1E-3
+#define FSECS_K            3
+#define FSECS_EPSILON      0.01
+#define FSECS_MIN_SAMPLES  10
+#define FSECS_MAX_SAMPLES  50
+
  /*
   * This constant determines the contributions of space utilization
   * (UTIL_WEIGHT) and throughput (1 - UTIL_WEIGHT) to the performance
@@ -62,4 +84,10 @@
  */
 #define MAX_HEAP (20*(1<<20))  /* 20 MB */
 
+/*
+ * Number of independent heaps (arenas) modeled by memlib, each of at
+ * most MAX_HEAP bytes. The mm package binds threads to arenas.
+ */
+#define MAX_ARENAS 8
+
 #endif /* __CONFIG_H */
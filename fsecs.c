@@ -1,51 +1,150 @@
 /****************************
  * High-level timing wrappers
  ****************************/
+#define _GNU_SOURCE  /* sched_getcpu, CPU_SET */
 #include <stdio.h>
-#include <sys/time.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include <sched.h>
 #include "fsecs.h"
 #include "config.h"
 
-static double Mhz;  /* estimated CPU clock frequency */
+static int select_mode;          /* FSECS_KBEST or FSECS_MEDIAN */
+static fsecs_stats_t last;       /* the runs behind the last fsecs result */
 
 extern int verbose; /* -v option in mdriver.c */
 
+static double now(void);
+static int cmp_double(const void *a, const void *b);
+static double t975(int df);
+
 /*
- * ftimer_gettod - Use gettimeofday to estimate the running time of
- * f(argp). Return the average of n runs.
+ * ftimer_gettod - Use clock_gettime(CLOCK_MONOTONIC) to estimate the
+ * running time of f(argp). Return the average of n runs.
  */
 double ftimer_gettod(ftimer_test_funct f, void *argp, int n)
 {
     int i;
-    struct timeval stv, etv;
-    double diff;
+    double start;
 
-    gettimeofday(&stv, NULL);
+    start = now();
     for (i = 0; i < n; i++)
 	f(argp);
-    gettimeofday(&etv,NULL);
-    diff = 1E3*(etv.tv_sec - stv.tv_sec) + 1E-3*(etv.tv_usec-stv.tv_usec);
-    diff /= n;
-    return (1E-3*diff);
+    return (now() - start) / n;
 }
 
 
 /*
- * init_fsecs - initialize the timing package
+ * init_fsecs - initialize the timing package; select is FSECS_KBEST or
+ * FSECS_MEDIAN
  */
-void init_fsecs(void)
+void init_fsecs(int select)
 {
-    Mhz = 0; /* keep gcc -Wall happy */
+    struct timespec res;
 
+    select_mode = select;
+    clock_getres(CLOCK_MONOTONIC, &res);
     if (verbose)
-	printf("Measuring performance with gettimeofday().\n");
+	printf("Measuring performance with clock_gettime() (%ld ns resolution), %s.\n",
+	       res.tv_nsec,
+	       (select == FSECS_MEDIAN) ? "median of the runs" : "K-best runs");
 }
 
 /*
- * fsecs - Return the running time of a function f (in seconds)
+ * fsecs - Return the running time of a function f (in seconds). After
+ *    FSECS_WARMUP untimed runs, f is timed in samples of at least
+ *    FSECS_MIN_SAMPLE seconds (several calls for a short f) until the
+ *    FSECS_K fastest samples are within FSECS_EPSILON of each other,
+ *    but at least FSECS_MIN_SAMPLES and at most FSECS_MAX_SAMPLES times.
+ *    The result is the fastest sample or the median one, per call. The
+ *    calling thread stays on one CPU meanwhile, threads it started
+ *    before keep their own affinity.
  */
 double fsecs(fsecs_test_funct f, void *argp)
 {
-    return ftimer_gettod(f, argp, 10);
+    double samples[FSECS_MAX_SAMPLES], sorted[FSECS_MAX_SAMPLES];
+    double t, sum, var;
+    cpu_set_t saved, one;
+    int pinned, reps, n, i;
+
+    /* Pin to the CPU we are on, so the runs don't migrate */
+    pinned = (sched_getaffinity(0, sizeof(saved), &saved) == 0 && sched_getcpu() >= 0);
+    if (pinned) {
+	CPU_ZERO(&one);
+	CPU_SET(sched_getcpu(), &one);
+	pinned = (sched_setaffinity(0, sizeof(one), &one) == 0);
+    }
+
+    /* Warm up caches, page tables and branch predictors; size the samples */
+    t = 0;
+    for (i = 0; i < FSECS_WARMUP; i++)
+	t = ftimer_gettod(f, argp, 1);
+    reps = (t > 0 && t < FSECS_MIN_SAMPLE) ? (int)(FSECS_MIN_SAMPLE / t) + 1 : 1;
+
+    n = 0;
+    do {
+	samples[n++] = ftimer_gettod(f, argp, reps);
+	for (i = 0; i < n; i++)
+	    sorted[i] = samples[i];
+	qsort(sorted, n, sizeof(double), cmp_double);
+    } while (n < FSECS_MAX_SAMPLES &&
+	     (n < FSECS_MIN_SAMPLES || sorted[FSECS_K - 1] > (1 + FSECS_EPSILON) * sorted[0]));
+
+    if (pinned)
+	sched_setaffinity(0, sizeof(saved), &saved);
+
+    /* Summarize the samples */
+    sum = 0;
+    for (i = 0; i < n; i++)
+	sum += samples[i];
+    var = 0;
+    for (i = 0; i < n; i++)
+	var += (samples[i] - sum / n) * (samples[i] - sum / n);
+    last.runs = n;
+    last.reps = reps;
+    last.min = sorted[0];
+    last.median = (n % 2) ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+    last.mean = sum / n;
+    last.ci95 = t975(n - 1) * sqrt(var / (n - 1)) / sqrt(n);
+
+    return (select_mode == FSECS_MEDIAN) ? last.median : last.min;
+}
+
+/*
+ * fsecs_last - Statistics of the samples of the last fsecs call
+ */
+void fsecs_last(fsecs_stats_t *stats)
+{
+    *stats = last;
+}
+
+/*
+ * now - seconds on the monotonic clock
+ */
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1E-9 * ts.tv_nsec;
 }
 
+/*
+ * cmp_double - qsort comparison for ascending doubles
+ */
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+/*
+ * t975 - 97.5% quantile of Student's t distribution with df degrees of
+ *    freedom, approximated within 1% for df >= 5
+ */
+static double t975(int df)
+{
+    return 1.96 + 2.4 / df;
+}
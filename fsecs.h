@@ -4,9 +4,24 @@
 typedef void (*ftimer_test_funct)(void *);
 typedef void (*fsecs_test_funct)(void *);
 
-/* Estimate the running time of f(argp) using gettimeofday
+/* Estimate the running time of f(argp) using clock_gettime
    Return the average of n runs */
 double ftimer_gettod(ftimer_test_funct f, void *argp, int n);
 
-void init_fsecs(void);
+/* How fsecs picks its result from the timed samples */
+#define FSECS_KBEST  0   /* the fastest, once the K fastest agree */
+#define FSECS_MEDIAN 1   /* the median */
+
+/* The samples behind an fsecs result, times are seconds per call of f */
+typedef struct {
+    int runs;        /* timed samples */
+    int reps;        /* calls of f per sample */
+    double min;      /* fastest sample */
+    double median;
+    double mean;
+    double ci95;     /* half width of the 95% confidence interval of the mean */
+} fsecs_stats_t;
+
+void init_fsecs(int select);
 double fsecs(fsecs_test_funct f, void *argp);
+void fsecs_last(fsecs_stats_t *stats);
@@ -0,0 +1,407 @@
+/*
+ * gentrace.c - Generate synthetic traces for mdriver
+ *
+ * A trace is made of phases, each with its own number of requests, size
+ * distribution, block lifetimes and live set; the options before the
+ * first -p describe the first phase, each -p starts another one that
+ * keeps the settings it does not change:
+ *
+ *     gentrace -o mixed.bin -n 1000000 -s uniform:16:128 -L 10000 \
+ *              -p -n 500000 -s power:16:65536:1.2 -L 100
+ *
+ * Every request allocates a new block, reallocates a random live one, or
+ * frees the live block whose lifetime is over. Lifetimes are counted in
+ * requests and their mean is chosen so that about L blocks are live, so
+ * the generator only keeps the live blocks in memory, in a heap ordered
+ * by the time they are freed, and can write traces of hundreds of
+ * millions of requests. The blocks still live after the last phase are
+ * freed at the end, so every trace is balanced.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <unistd.h>
+#include <math.h>
+
+#include "trace.h"
+
+#define MAXPHASES 64
+
+/* Size distributions */
+#define SIZE_UNIFORM 0     /* lo .. hi */
+#define SIZE_POWER   1     /* lo .. hi, density falling as size^-(alpha+1) */
+#define SIZE_BIMODAL 2     /* lo with probability p, else hi */
+
+/* Lifetime distributions, all with the mean that gives the live set */
+#define LIFE_EXP     0     /* exponential */
+#define LIFE_UNIFORM 1     /* 0 .. twice the mean */
+#define LIFE_POWER   2     /* Pareto with shape alpha > 1: few live long */
+
+/* The parameters of a phase */
+typedef struct {
+    long ops;              /* requests */
+    int size_dist;
+    size_t lo, hi;         /* size range, or the two sizes of bimodal */
+    double size_param;     /* alpha of power, p of bimodal */
+    int life_dist;
+    double life_alpha;     /* alpha of power */
+    long live;             /* blocks live on average */
+    double realloc_pct;    /* percent of the requests that reallocate */
+} phase_t;
+
+/* A live block, in the heap of blocks ordered by death */
+typedef struct {
+    uint64_t death;        /* number of the request that frees it */
+    int id;
+    size_t size;
+} block_t;
+
+static block_t *heap = NULL;   /* heap[0] dies first */
+static long heap_len = 0, heap_cap = 0;
+static uint64_t rng_state = 88172645463325252ULL;
+
+static FILE *out;
+static int text = 0;           /* write a text trace, else a binary one */
+static long num_ops = 0;
+static int num_ids = 0;
+
+static void usage(void);
+static void parse_size(phase_t *ph, char *arg);
+static void parse_life(phase_t *ph, char *arg);
+static void run_phase(phase_t *ph, uint64_t *now);
+static void emit(int type, int id, size_t size);
+static void write_header(void);
+static size_t draw_size(phase_t *ph);
+static uint64_t draw_life(phase_t *ph);
+static double uniform(void);
+static void heap_push(block_t b);
+static block_t heap_pop(void);
+static void heap_sift_down(long i);
+
+int main(int argc, char **argv)
+{
+    phase_t phases[MAXPHASES];
+    int num_phases = 1, i, c;
+    char *outfile = NULL;
+    uint64_t now = 0;
+
+    /* The defaults of the first phase */
+    phases[0].ops = 100000;
+    phases[0].size_dist = SIZE_UNIFORM;
+    phases[0].lo = 1;
+    phases[0].hi = 1024;
+    phases[0].size_param = 0;
+    phases[0].life_dist = LIFE_EXP;
+    phases[0].life_alpha = 0;
+    phases[0].live = 1000;
+    phases[0].realloc_pct = 0;
+
+    while ((c = getopt(argc, argv, "o:n:s:l:L:r:S:pTh")) != EOF) {
+	phase_t *ph = &phases[num_phases - 1];
+
+	switch (c) {
+	case 'o': /* Output file */
+	    outfile = optarg;
+	    break;
+	case 'n': /* Requests of the phase */
+	    if ((ph->ops = atol(optarg)) <= 0)
+		usage();
+	    break;
+	case 's': /* Size distribution */
+	    parse_size(ph, optarg);
+	    break;
+	case 'l': /* Lifetime distribution */
+	    parse_life(ph, optarg);
+	    break;
+	case 'L': /* Live blocks */
+	    if ((ph->live = atol(optarg)) <= 0)
+		usage();
+	    break;
+	case 'r': /* Percent reallocs */
+	    ph->realloc_pct = atof(optarg);
+	    if (ph->realloc_pct < 0 || ph->realloc_pct >= 100)
+		usage();
+	    break;
+	case 'S': /* Seed */
+	    rng_state = strtoull(optarg, NULL, 0) * 2685821657736338717ULL + 1;
+	    break;
+	case 'p': /* Next phase, like this one */
+	    if (num_phases == MAXPHASES)
+		usage();
+	    phases[num_phases] = *ph;
+	    num_phases++;
+	    break;
+	case 'T': /* Text trace */
+	    text = 1;
+	    break;
+	default:
+	    usage();
+	}
+    }
+    if (outfile == NULL || optind != argc)
+	usage();
+
+    if ((out = fopen(outfile, "w")) == NULL) {
+	perror(outfile);
+	exit(1);
+    }
+    write_header(); /* a placeholder, num_ids and num_ops come last */
+
+    for (i = 0; i < num_phases; i++)
+	run_phase(&phases[i], &now);
+    while (heap_len > 0) { /* balance the trace */
+	block_t b = heap_pop();
+	emit(TRACE_FREE, b.id, b.size);
+    }
+
+    rewind(out);
+    write_header();
+    if (fclose(out) != 0) {
+	perror(outfile);
+	exit(1);
+    }
+    fprintf(stderr, "%s: %d ids, %ld requests\n", outfile, num_ids, num_ops);
+    exit(0);
+}
+
+/*
+ * parse_size - Parse uniform:lo:hi, power:lo:hi:alpha or bimodal:a:b:p
+ */
+static void parse_size(phase_t *ph, char *arg)
+{
+    unsigned long lo, hi;
+    double x;
+
+    if (sscanf(arg, "uniform:%lu:%lu", &lo, &hi) == 2)
+	ph->size_dist = SIZE_UNIFORM;
+    else if (sscanf(arg, "power:%lu:%lu:%lf", &lo, &hi, &x) == 3 && x > 0)
+	ph->size_dist = SIZE_POWER;
+    else if (sscanf(arg, "bimodal:%lu:%lu:%lf", &lo, &hi, &x) == 3 &&
+	     x >= 0 && x <= 1)
+	ph->size_dist = SIZE_BIMODAL;
+    else
+	usage();
+    if (lo == 0 || (ph->size_dist != SIZE_BIMODAL && hi < lo))
+	usage();
+    ph->lo = lo;
+    ph->hi = hi;
+    ph->size_param = x;
+}
+
+/*
+ * parse_life - Parse exp, uniform or power:alpha
+ */
+static void parse_life(phase_t *ph, char *arg)
+{
+    double alpha;
+
+    if (!strcmp(arg, "exp"))
+	ph->life_dist = LIFE_EXP;
+    else if (!strcmp(arg, "uniform"))
+	ph->life_dist = LIFE_UNIFORM;
+    else if (sscanf(arg, "power:%lf", &alpha) == 1 && alpha > 1) {
+	ph->life_dist = LIFE_POWER;
+	ph->life_alpha = alpha;
+    }
+    else
+	usage();
+}
+
+/*
+ * run_phase - Generate the requests of a phase; *now counts them over
+ *     all phases
+ */
+static void run_phase(phase_t *ph, uint64_t *now)
+{
+    long k, i;
+    block_t b;
+
+    for (k = 0; k < ph->ops; k++) {
+	(*now)++;
+	if (num_ops >= INT_MAX - heap_len - 1) {
+	    fprintf(stderr, "gentrace: more requests than a trace can hold\n");
+	    exit(1);
+	}
+
+	if (heap_len > 0 && heap[0].death <= *now) {
+	    b = heap_pop();
+	    emit(TRACE_FREE, b.id, b.size);
+	}
+	else if (heap_len > 0 && 100 * uniform() < ph->realloc_pct) {
+	    i = (long)(uniform() * heap_len);
+	    heap[i].size = draw_size(ph);
+	    emit(TRACE_REALLOC, heap[i].id, heap[i].size);
+	}
+	else {
+	    b.id = num_ids++;
+	    b.size = draw_size(ph);
+	    b.death = *now + draw_life(ph);
+	    heap_push(b);
+	    emit(TRACE_ALLOC, b.id, b.size);
+	}
+    }
+}
+
+/*
+ * emit - Write a request
+ */
+static void emit(int type, int id, size_t size)
+{
+    trace_rec_t r;
+
+    num_ops++;
+    if (text) {
+	if (type == TRACE_FREE)
+	    fprintf(out, "f %d\n", id);
+	else
+	    fprintf(out, "%c %d %zu\n", type == TRACE_ALLOC ? 'a' : 'r',
+		    id, size);
+	return;
+    }
+    r.type = type;
+    r.index = id;
+    r.size = size;
+    r.align = 0;
+    fwrite(&r, sizeof(r), 1, out);
+}
+
+/*
+ * write_header - Write the header of the trace; the text header is
+ *     padded, so the final one fits over the placeholder
+ */
+static void write_header(void)
+{
+    trace_hdr_t hdr;
+
+    if (text) {
+	fprintf(out, "%11d\n%11d\n%11ld\n%11d\n", 0, num_ids, num_ops, 1);
+	return;
+    }
+    memcpy(hdr.magic, TRACE_MAGIC, sizeof(hdr.magic));
+    hdr.sugg_heapsize = 0;
+    hdr.num_ids = num_ids;
+    hdr.num_ops = num_ops;
+    hdr.weight = 1;
+    fwrite(&hdr, sizeof(hdr), 1, out);
+}
+
+/*
+ * draw_size - A request size from the distribution of the phase
+ */
+static size_t draw_size(phase_t *ph)
+{
+    double a, lo, hi;
+
+    switch (ph->size_dist) {
+    case SIZE_POWER: /* inverse of the truncated Pareto distribution */
+	a = ph->size_param;
+	lo = pow((double)ph->lo, -a);
+	hi = pow((double)ph->hi + 1, -a);
+	return (size_t)pow(lo - uniform() * (lo - hi), -1 / a);
+    case SIZE_BIMODAL:
+	return (uniform() < ph->size_param) ? ph->lo : ph->hi;
+    default:
+	return ph->lo + (size_t)(uniform() * (ph->hi - ph->lo + 1));
+    }
+}
+
+/*
+ * draw_life - A lifetime in requests, at least 1. Half of the requests
+ *     allocate in the steady state, and some reallocate, so blocks that
+ *     live 2 * live / (1 - realloc share) requests on average keep live
+ *     blocks alive at a time.
+ */
+static uint64_t draw_life(phase_t *ph)
+{
+    double mean = 2.0 * ph->live / (1 - ph->realloc_pct / 100), t;
+    double a = ph->life_alpha;
+
+    switch (ph->life_dist) {
+    case LIFE_UNIFORM:
+	t = 2 * mean * uniform();
+	break;
+    case LIFE_POWER: /* Pareto with that mean */
+	t = mean * (a - 1) / a * pow(1 - uniform(), -1 / a);
+	break;
+    default:
+	t = -mean * log(1 - uniform());
+    }
+    return (t < 1) ? 1 : (t > 1E18) ? (uint64_t)1E18 : (uint64_t)t;
+}
+
+/*
+ * uniform - A random number in [0, 1), from xorshift64*
+ */
+static double uniform(void)
+{
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return ((rng_state * 2685821657736338717ULL) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/*
+ * heap_push, heap_pop, heap_sift_down - The binary min-heap of live
+ *     blocks by death
+ */
+static void heap_push(block_t b)
+{
+    long i;
+
+    if (heap_len == heap_cap) {
+	heap_cap = heap_cap ? 2 * heap_cap : 1024;
+	if ((heap = realloc(heap, heap_cap * sizeof(block_t))) == NULL) {
+	    fprintf(stderr, "gentrace: out of memory\n");
+	    exit(1);
+	}
+    }
+    for (i = heap_len++; i > 0 && heap[(i - 1) / 2].death > b.death;
+	 i = (i - 1) / 2)
+	heap[i] = heap[(i - 1) / 2];
+    heap[i] = b;
+}
+
+static block_t heap_pop(void)
+{
+    block_t top = heap[0];
+
+    heap[0] = heap[--heap_len];
+    heap_sift_down(0);
+    return top;
+}
+
+static void heap_sift_down(long i)
+{
+    block_t b = heap[i];
+    long c;
+
+    while ((c = 2 * i + 1) < heap_len) {
+	if (c + 1 < heap_len && heap[c + 1].death < heap[c].death)
+	    c++;
+	if (b.death <= heap[c].death)
+	    break;
+	heap[i] = heap[c];
+	i = c;
+    }
+    heap[i] = b;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "Usage: gentrace -o <file> [-T] [-S <seed>] <phase> [-p <phase>]...\n");
+    fprintf(stderr, "A phase is described by these options, -p starts the next one:\n");
+    fprintf(stderr, "\t-n <ops>   Requests in the phase (100000).\n");
+    fprintf(stderr, "\t-s <dist>  Request sizes: uniform:lo:hi (uniform:1:1024),\n");
+    fprintf(stderr, "\t           power:lo:hi:alpha (density ~ size^-(alpha+1)),\n");
+    fprintf(stderr, "\t           bimodal:a:b:p (a with probability p, else b).\n");
+    fprintf(stderr, "\t-l <dist>  Lifetimes: exp, uniform or power:alpha (alpha > 1).\n");
+    fprintf(stderr, "\t-L <n>     Blocks live on average (1000).\n");
+    fprintf(stderr, "\t-r <pct>   Percent of the requests that reallocate a live block (0).\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-o <file>  Write the trace to <file>.\n");
+    fprintf(stderr, "\t-T         Write a text trace instead of a binary one.\n");
+    fprintf(stderr, "\t-S <seed>  Seed of the random numbers.\n");
+    exit(1);
+}
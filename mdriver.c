@@ -14,13 +14,21 @@
 #include <string.h>
 #include <assert.h>
 #include <float.h>
+#include <limits.h>
 #include <time.h>
 #include <stdint.h>
+#include <sched.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "mm.h"
 #include "memlib.h"
 #include "fsecs.h"
 #include "config.h"
+#include "trace.h"
 
 /**********************
  * Constants and macros
@@ -30,28 +38,46 @@
 #define MAXLINE     1024 /* max string size */
 #define HDRLINES       4 /* number of header lines in a trace file */
 #define LINENUM(i) (i+5) /* cnvt trace request nums to linenums (origin 1) */
+#define MAXTHREADS    64 /* max number of replay threads (-T) */
+#define RANGE_CHUNK 4096 /* range records malloc'd at a time */
+#define STREAM_CHUNK 65536 /* requests per buffer of the streaming replay */
+#define ID_PAGE     4096 /* ids per page of the streaming replay's id table */
 
-/* Returns true if p is ALIGNMENT-byte aligned */
-#define IS_ALIGNED(p)  ((((uintptr_t)(p)) % ALIGNMENT) == 0)
+/* Returns true if p is align-byte aligned */
+#define IS_ALIGNED(p, align)  ((((uintptr_t)(p)) % (align)) == 0)
 
 /******************************
  * The key compound data types
  *****************************/
 
-/* Records the extent of each block's payload */
+/* Records the extent of each block's payload, as a node of a treap
+   ordered by address */
 typedef struct range_t {
     char *lo;              /* low payload address */
     char *hi;              /* high payload address */
-    struct range_t *next;  /* next list element */
+    unsigned int prio;     /* random, no child has a higher one */
+    struct range_t *left;  /* ranges below (next free record in the pool) */
+    struct range_t *right; /* ranges above */
 } range_t;
 
 /* Characterizes a single trace operation (allocator request) */
 typedef struct {
-    enum {ALLOC, FREE} type; /* type of request */
+    enum {ALLOC = TRACE_ALLOC, FREE = TRACE_FREE, REALLOC = TRACE_REALLOC}
+        type;                         /* type of request */
     int index;                        /* index for free() to use later */
-    int size;                         /* byte size of alloc request */
+    size_t size;                      /* byte size of alloc request, or
+					 of the block a free releases */
+    size_t align;                     /* alignment of an aligned alloc
+					 request, 0 for any other */
 } traceop_t;
 
+/* The records of a binary trace are replayed in place as traceop_t */
+_Static_assert(sizeof(traceop_t) == sizeof(trace_rec_t) &&
+	       offsetof(traceop_t, index) == offsetof(trace_rec_t, index) &&
+	       offsetof(traceop_t, size) == offsetof(trace_rec_t, size) &&
+	       offsetof(traceop_t, align) == offsetof(trace_rec_t, align),
+	       "traceop_t must have the layout of trace_rec_t");
+
 /* Holds the information for one trace file*/
 typedef struct {
     int sugg_heapsize;   /* suggested heap size (unused) */
@@ -59,10 +85,43 @@ typedef struct {
     int num_ops;         /* number of distinct requests */
     int weight;          /* weight for this trace (unused) */
     traceop_t *ops;      /* array of requests */
+    void *map;           /* mapping ops points into, NULL for a text trace */
+    size_t map_len;      /* ... and its length */
     char **blocks;       /* array of ptrs returned by malloc ... */
     size_t *block_sizes; /* ... and a corresponding array of payload sizes */
 } trace_t;
 
+/* A block of the streaming (-S) replay */
+typedef struct {
+    char *p;             /* payload, NULL while the id has no block */
+    size_t size;         /* ... and its byte size */
+} idslot_t;
+
+/* The blocks of the streaming replay by id, ID_PAGE ids to a page. A
+   page is allocated with the first block of its ids and freed with the
+   last one, so the table grows with the blocks in use, not the trace */
+typedef struct {
+    idslot_t **pages;    /* NULL for a page without blocks */
+    int *live;           /* blocks on each page */
+    int num_pages;
+} idtable_t;
+
+/* Reads a trace for the streaming replay, one buffer ahead of it */
+typedef struct {
+    FILE *file;
+    char *path;
+    int binary;          /* binary trace, else text */
+    int num_ids;         /* from the header of the trace */
+    int num_ops;
+    int read;            /* requests read so far */
+    traceop_t *buf[2];   /* one is filled while the replay drains the other */
+    int count[2];        /* requests in each buffer, -1 while it is empty */
+    int quit;            /* tells the reader to exit */
+    pthread_mutex_t lock;
+    pthread_cond_t cond; /* a buffer was filled or emptied */
+    pthread_t thread;
+} stream_t;
+
 /*
  * Holds the params to the xxx_speed functions, which are timed by fcyc.
  * This struct is necessary because fcyc accepts only a pointer array
@@ -71,17 +130,66 @@ typedef struct {
 typedef struct {
     trace_t *trace;
     range_t *ranges;
+
+    /* only used by the concurrent (-T) replay */
+    struct replay_t *threads; /* one record per replay thread */
+    int *seq;            /* per request: number of earlier requests on its id */
+    int *done;           /* per id: number of its requests completed so far */
+    int libc;            /* replay with libc malloc instead of mm malloc */
+    int quit;            /* tells the replay threads to exit */
+    pthread_barrier_t start, end; /* bracket each run of the threads */
 } speed_t;
 
+/* One thread of the concurrent (-T) replay */
+typedef struct replay_t {
+    speed_t *speed;      /* trace and shared replay state */
+    int tid;             /* thread number, 0 .. num_threads-1 */
+    char **blocks;       /* block pointers (private array in copies mode) */
+    int ops;             /* requests this thread executed in the last run */
+    double secs;         /* ... and the time it needed for them */
+    pthread_t thread;
+} replay_t;
+
+/* How the concurrent replay distributes a trace over the threads */
+typedef enum {
+    REPLAY_SPLIT,        /* ids are partitioned over the threads */
+    REPLAY_COPIES,       /* every thread replays its own copy of the trace */
+    REPLAY_XFREE         /* like split, but blocks are freed by the next thread */
+} replay_mode_t;
+
 /* Summarizes the important stats for some malloc function on some trace */
+#define HEAP_SAMPLES 4
+#define NUM_PCTS 5        /* percentiles reported by -p */
 typedef struct {
     /* defined for both libc malloc and student malloc package (mm.c) */
-    double ops;      /* number of ops (malloc/free) in the trace */
+    double ops;      /* number of ops (malloc/free/realloc) in the trace */
     int valid;       /* was the trace processed correctly by the allocator? */
     double secs;     /* number of secs needed to run the trace */
 
     /* defined only for the student malloc package */
     double util;     /* space utilization for this trace (always 0 for libc) */
+    int reallocs;    /* number of realloc requests in the trace */
+    int inplace;     /* ... and how many of them kept their block address */
+
+    /* defined only for the concurrent (-T) replay */
+    double lat_min;  /* fastest thread, nanoseconds per request */
+    double lat_avg;  /* average over the threads */
+    double lat_max;  /* slowest thread */
+
+    /* heap size over the utilization run of the student malloc package */
+    size_t heap_peak;             /* highest brk */
+    size_t heap[HEAP_SAMPLES];    /* brk after each quarter of the requests */
+    size_t resident[HEAP_SAMPLES];/* ... and the part of it in memory */
+
+    /* the timed samples behind secs */
+    fsecs_stats_t timing;
+
+    /* defined only for the streaming (-S) replay */
+    double stall;    /* secs the timed replay waited for the trace reader */
+
+    /* MM_PROFILE histograms of the last timed run of the mm package (-p) */
+    unsigned long prof_count[MM_PROF_EVENTS];       /* calls (searches) */
+    unsigned long prof[MM_PROF_EVENTS][NUM_PCTS];   /* ... their percentiles */
 
     /* Note: secs and util are only defined if valid is true */
 } stats_t;
@@ -93,6 +201,50 @@ int verbose = 0;        /* global flag for verbose output */
 static int errors = 0;  /* number of errs found when running student malloc */
 char msg[MAXLINE];      /* for whenever we need to compose an error message */
 
+/* Concurrent replay (-T, -R) */
+static int num_threads = 0;               /* 0: replay sequentially */
+static replay_mode_t replay_mode = REPLAY_SPLIT;
+
+/* Placement policy of the mm package (-P) */
+#define NUM_POLICIES  3
+#define ALL_POLICIES -2   /* -P all: compare every policy */
+static int policy = -1;   /* -1: leave the package default */
+static int best_fit_k = 0;/* candidates for best fit, 0: package default */
+static char *policy_names[NUM_POLICIES] = {"first", "best", "addr"};
+
+/* Giving memory back (-m), 0: leave the package default */
+static long trim_threshold = 0;
+static long release_threshold = 0;
+
+/* Deferred coalescing (-d): percent of the heap in deferred blocks, 0: off */
+static int defer = 0;
+
+/* Learned rounding (-r): percent requests may be rounded up, -1: leave the package default */
+static int round_pct = -1;
+
+/* Batched replay (-b): runs of same-size allocations or of frees */
+#define BATCH_MAX 64      /* requests per mm_malloc_batch / mm_free_batch */
+static int batch = 0;
+
+/* Sized frees (-s): replay frees with mm_free_sized */
+static int sized = 0;
+
+/* Timing (-M): the fastest run once the K fastest agree, or the median */
+static int fsecs_select = FSECS_KBEST;
+
+/* Streaming replay (-S): read the traces while they are replayed */
+static int stream = 0;
+
+/* Profiling (-p): percentiles of the histograms of an MM_PROFILE build */
+static int profile = 0;
+static double pcts[NUM_PCTS] = {50, 90, 99, 99.9, 100};
+static char *prof_names[MM_PROF_EVENTS] = {
+    "mm_malloc", "mm_free", "coalesce", "extend_heap", "fit search"};
+
+/* Range records not in use, and the state of their random priorities */
+static range_t *range_pool = NULL;
+static unsigned int range_seed = 2463534242u;
+
 /* Directory where default tracefiles are found */
 static char tracedir[MAXLINE] = TRACEDIR;
 
@@ -101,20 +253,36 @@ static char *default_tracefiles[] = {
     DEFAULT_TRACEFILES, NULL
 };
 
+/* ... and with the realloc traces (-e) */
+static char *realloc_tracefiles[] = {
+    DEFAULT_TRACEFILES, REALLOC_TRACEFILES, NULL
+};
+static int with_realloc = 0;
+
 
 /*********************
  * Function prototypes
  *********************/
 
-/* these functions manipulate range lists */
-static int add_range(range_t **ranges, char *lo, int size,
+/* these functions manipulate range trees */
+static int add_range(range_t **ranges, char *lo, size_t size, size_t align,
 		     int tracenum, int opnum);
 static void remove_range(range_t **ranges, char *lo);
 static void clear_ranges(range_t **ranges);
+static range_t *insert_range(range_t *t, range_t *p);
+static range_t *join_ranges(range_t *a, range_t *b);
 
 /* These functions read, allocate, and free storage for traces */
 static trace_t *read_trace(char *tracedir, char *filename);
 static void free_trace(trace_t *trace);
+static int parse_op(FILE *tracefile, traceop_t *op, char *path,
+		    unsigned op_index);
+static int bad_op(traceop_t *op, int num_ids);
+static int map_trace(trace_t *trace, FILE *tracefile, char *path);
+static int load_capture(trace_t *trace, FILE *tracefile, char *path);
+static int cmp_seq(const void *a, const void *b);
+static void check_trace(trace_t *trace, char *path);
+static void write_trace(trace_t *trace, char *path);
 
 /* Routines for evaluating the correctness and speed of libc malloc */
 static int eval_libc_valid(trace_t *trace, int tracenum);
@@ -122,12 +290,47 @@ static void eval_libc_speed(void *ptr);
 
 /* Routines for evaluating correctnes, space utilization, and speed
    of the student's malloc package in mm.c */
-static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges);
-static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges);
+static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges,
+			 stats_t *stats);
+static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges,
+			   stats_t *stats);
 static void eval_mm_speed(void *ptr);
+static int batch_run(trace_t *trace, int opnum);
+static void eval_mm_traces(int num_tracefiles, char **tracefiles,
+			   stats_t *mm_stats, range_t **ranges);
+
+/* Routines for the concurrent replay of a trace (-T) */
+static void start_replay(speed_t *speed, trace_t *trace, int libc);
+static void stop_replay(speed_t *speed);
+static void eval_speed_mt(void *ptr);
+static void *replay_thread(void *ptr);
+static void replay_latency(speed_t *speed, stats_t *stats);
+static void profile_percentiles(stats_t *stats);
+
+/* Routines for the streaming replay of a trace (-S) */
+static void stream_mm_traces(int num_tracefiles, char **tracefiles,
+			     stats_t *mm_stats, range_t **ranges);
+static int stream_mm(char *path, int tracenum, int checked, range_t **ranges,
+		     stats_t *stats);
+static void open_stream(stream_t *s, char *path);
+static void close_stream(stream_t *s);
+static void *stream_reader(void *ptr);
+static int read_chunk(stream_t *s, traceop_t *buf);
+static int next_chunk(stream_t *s, int b, double *stall);
+static void done_chunk(stream_t *s, int b);
+static idslot_t *id_get(idtable_t *t, int index);
+static void id_put(idtable_t *t, int index, char *p, size_t size);
+static double now(void);
 
 /* Various helper routines */
 static void printresults(int n, stats_t *stats);
+static void printreallocs(int n, stats_t *stats);
+static void printthreads(int n, stats_t *stats);
+static void printpolicies(int n, stats_t **stats);
+static void printheap(int n, stats_t *stats);
+static void printprofile(int n, stats_t *stats);
+static void printtiming(int n, stats_t *stats);
+static void printstalls(int n, stats_t *stats);
 static void usage(void);
 static void unix_error(char *msg);
 static void malloc_error(int tracenum, int opnum, char *msg);
@@ -146,11 +349,15 @@ int main(int argc, char **argv)
     range_t *ranges = NULL;    /* keeps track of block extents for one trace */
     stats_t *libc_stats = NULL;/* libc stats for each trace */
     stats_t *mm_stats = NULL;  /* mm (i.e. student) stats for each trace */
+    stats_t *policy_stats[NUM_POLICIES] = {NULL}; /* mm stats per policy */
     speed_t speed_params;      /* input parameters to the xx_speed routines */
 
+    char *convert_file = NULL; /* binary trace to write (-c) */
     int group_check = 1;  /* If set, check group structure (reset by -a) */
     int run_libc = 0;    /* If set, run libc malloc (set by -l) */
     int autograder = 0;  /* If set, emit summary info for autograder (-g) */
+    int p;
+    char *k;
 
     /* temporaries used to compute the performance index */
     double secs, ops, util, avg_mm_util, avg_mm_throughput, p1, p2, perfindex;
@@ -159,11 +366,14 @@ int main(int argc, char **argv)
     /*
      * Read and interpret the command line arguments
      */
-    while ((c = getopt(argc, argv, "f:t:hvVgal")) != EOF) {
+    while ((c = getopt(argc, argv, "f:t:T:R:P:m:d:r:M:c:bsSphvVgale")) != EOF) {
         switch (c) {
 	case 'g': /* Generate summary info for the autograder */
 	    autograder = 1;
 	    break;
+	case 'e': /* Run the realloc traces as well */
+	    with_realloc = 1;
+	    break;
         case 'f': /* Use one specific trace file only (relative to curr dir) */
             num_tracefiles = 1;
             if ((tracefiles = realloc(tracefiles, 2*sizeof(char *))) == NULL)
@@ -179,6 +389,92 @@ int main(int argc, char **argv)
 	    if (tracedir[strlen(tracedir)-1] != '/')
 		strcat(tracedir, "/"); /* path always ends with "/" */
 	    break;
+	case 'T': /* Replay each trace with this many threads */
+	    num_threads = atoi(optarg);
+	    if (num_threads < 1 || num_threads > MAXTHREADS) {
+		usage();
+		exit(1);
+	    }
+	    break;
+	case 'R': /* How the threads of -T share a trace */
+	    if (!strcmp(optarg, "split"))
+		replay_mode = REPLAY_SPLIT;
+	    else if (!strcmp(optarg, "copies"))
+		replay_mode = REPLAY_COPIES;
+	    else if (!strcmp(optarg, "xfree"))
+		replay_mode = REPLAY_XFREE;
+	    else {
+		usage();
+		exit(1);
+	    }
+	    break;
+	case 'P': /* Placement policy of the mm package */
+	    if ((k = strchr(optarg, ':')) != NULL) { /* best:K */
+		*k++ = '\0';
+		if ((best_fit_k = atoi(k)) <= 0) {
+		    usage();
+		    exit(1);
+		}
+	    }
+	    policy = ALL_POLICIES;
+	    for (p = 0; p < NUM_POLICIES; p++)
+		if (!strcmp(optarg, policy_names[p]))
+		    policy = p;
+	    if (policy == ALL_POLICIES && strcmp(optarg, "all")) {
+		usage();
+		exit(1);
+	    }
+	    break;
+	case 'm': /* Give memory back: trim threshold[:release threshold] */
+	    if ((k = strchr(optarg, ':')) != NULL) {
+		*k++ = '\0';
+		if ((release_threshold = atol(k)) <= 0) {
+		    usage();
+		    exit(1);
+		}
+	    }
+	    if ((trim_threshold = atol(optarg)) < 0) {
+		usage();
+		exit(1);
+	    }
+	    break;
+	case 'd': /* Deferred coalescing */
+	    if ((defer = atoi(optarg)) <= 0 || defer > 100) {
+		usage();
+		exit(1);
+	    }
+	    break;
+	case 'r': /* Learned rounding */
+	    if ((round_pct = atoi(optarg)) < 0 || round_pct > 100) {
+		usage();
+		exit(1);
+	    }
+	    break;
+	case 'M': /* How the timed runs of a trace are summarized */
+	    if (!strcmp(optarg, "kbest"))
+		fsecs_select = FSECS_KBEST;
+	    else if (!strcmp(optarg, "median"))
+		fsecs_select = FSECS_MEDIAN;
+	    else {
+		usage();
+		exit(1);
+	    }
+	    break;
+	case 'c': /* Convert the trace of -f to the binary format */
+	    convert_file = optarg;
+	    break;
+	case 'b': /* Batched replay */
+	    batch = 1;
+	    break;
+	case 's': /* Sized frees */
+	    sized = 1;
+	    break;
+	case 'S': /* Streaming replay */
+	    stream = 1;
+	    break;
+	case 'p': /* Percentiles of the mm package's profile */
+	    profile = 1;
+	    break;
         case 'a': /* Don't check group structure */
             group_check = 0;
             break;
@@ -200,6 +496,30 @@ int main(int argc, char **argv)
         }
     }
 
+    /* The streaming replay reads each trace once per pass, by itself */
+    if (stream && (num_threads || batch || run_libc)) {
+	usage();
+	exit(1);
+    }
+
+    /* The threads of -T replay their requests one at a time */
+    if (batch && num_threads) {
+	usage();
+	exit(1);
+    }
+
+    /* -c converts the one trace of -f, and does nothing else */
+    if (convert_file) {
+	if (num_tracefiles != 1) {
+	    usage();
+	    exit(1);
+	}
+	trace = read_trace(tracedir, tracefiles[0]);
+	write_trace(trace, convert_file);
+	free_trace(trace);
+	exit(0);
+    }
+
     /*
      * Check and print group info
      */
@@ -238,14 +558,26 @@ int main(int argc, char **argv)
      * If no -f command line arg, then use the entire set of tracefiles
      * defined in default_traces[]
      */
-    if (tracefiles == NULL) {
+    if (tracefiles == NULL && with_realloc) {
+        tracefiles = realloc_tracefiles;
+        num_tracefiles = sizeof(realloc_tracefiles) / sizeof(char *) - 1;
+	printf("Using default and realloc tracefiles in %s\n", tracedir);
+    }
+    else if (tracefiles == NULL) {
         tracefiles = default_tracefiles;
         num_tracefiles = sizeof(default_tracefiles) / sizeof(char *) - 1;
 	printf("Using default tracefiles in %s\n", tracedir);
     }
 
+    /* -p reads the histograms of a package compiled for profiling */
+    if (profile) {
+	mm_profile_t prof;
+	if (!mm_get_profile(&prof))
+	    app_error("-p needs mm.c compiled with MM_PROFILE (make PROFILE=1)");
+    }
+
     /* Initialize the timing package */
-    init_fsecs();
+    init_fsecs(fsecs_select);
 
     /*
      * Optionally run and evaluate the libc malloc package
@@ -270,7 +602,17 @@ int main(int argc, char **argv)
 		speed_params.trace = trace;
 		if (verbose > 1)
 		    printf("and performance.\n");
-		libc_stats[i].secs = fsecs(eval_libc_speed, &speed_params);
+		if (num_threads) {
+		    start_replay(&speed_params, trace, 1);
+		    libc_stats[i].secs = fsecs(eval_speed_mt, &speed_params);
+		    fsecs_last(&libc_stats[i].timing);
+		    replay_latency(&speed_params, &libc_stats[i]);
+		    stop_replay(&speed_params);
+		}
+		else {
+		    libc_stats[i].secs = fsecs(eval_libc_speed, &speed_params);
+		    fsecs_last(&libc_stats[i].timing);
+		}
 	    }
 	    free_trace(trace);
 	}
@@ -279,6 +621,8 @@ int main(int argc, char **argv)
 	if (verbose) {
 	    printf("\nResults for libc malloc:\n");
 	    printresults(num_tracefiles, libc_stats);
+	    printtiming(num_tracefiles, libc_stats);
+	    printthreads(num_tracefiles, libc_stats);
 	}
     }
 
@@ -288,41 +632,81 @@ int main(int argc, char **argv)
     if (verbose > 1)
 	printf("\nTesting mm malloc\n");
 
-    /* Allocate the mm stats array, with one stats_t struct per tracefile */
-    mm_stats = (stats_t *)calloc(num_tracefiles, sizeof(stats_t));
-    if (mm_stats == NULL)
-	unix_error("mm_stats calloc in main failed");
+    /* The mm package has to be thread-safe for the concurrent replay */
+    if (num_threads && !mm_setopt(MM_OPT_THREADS, 1))
+	app_error("mm_setopt(MM_OPT_THREADS) failed");
+    if (best_fit_k && !mm_setopt(MM_OPT_BEST_FIT_K, best_fit_k))
+	app_error("mm_setopt(MM_OPT_BEST_FIT_K) failed");
+    if (trim_threshold && !mm_setopt(MM_OPT_TRIM_THRESHOLD, trim_threshold))
+	app_error("mm_setopt(MM_OPT_TRIM_THRESHOLD) failed");
+    if (release_threshold &&
+	!mm_setopt(MM_OPT_RELEASE_THRESHOLD, release_threshold))
+	app_error("mm_setopt(MM_OPT_RELEASE_THRESHOLD) failed");
+    if (defer && !mm_setopt(MM_OPT_DEFER, defer))
+	app_error("mm_setopt(MM_OPT_DEFER) failed");
+    if (round_pct >= 0 && !mm_setopt(MM_OPT_ROUND, round_pct))
+	app_error("mm_setopt(MM_OPT_ROUND) failed");
 
     /* Initialize the simulated memory system in memlib.c */
     mem_init();
 
-    /* Evaluate student's mm malloc package using the K-best scheme */
-    for (i=0; i < num_tracefiles; i++) {
-	trace = read_trace(tracedir, tracefiles[i]);
-	mm_stats[i].ops = trace->num_ops;
-	if (verbose > 1)
-	    printf("Checking mm_malloc for correctness, ");
-	mm_stats[i].valid = eval_mm_valid(trace, i, &ranges);
-	if (mm_stats[i].valid) {
-	    if (verbose > 1)
-		printf("efficiency, ");
-	    mm_stats[i].util = eval_mm_util(trace, i, &ranges);
-	    speed_params.trace = trace;
-	    speed_params.ranges = ranges;
-	    if (verbose > 1)
-		printf("and performance.\n");
-	    mm_stats[i].secs = fsecs(eval_mm_speed, &speed_params);
+    if (policy == ALL_POLICIES) {
+	/*
+	 * Evaluate the package once per placement policy; the performance
+	 * index is the one of the default policy, first fit
+	 */
+	for (p = 0; p < NUM_POLICIES; p++) {
+	    if (!mm_setopt(MM_OPT_POLICY, p))
+		app_error("mm_setopt(MM_OPT_POLICY) failed");
+	    policy_stats[p] = (stats_t *)calloc(num_tracefiles, sizeof(stats_t));
+	    if (policy_stats[p] == NULL)
+		unix_error("policy_stats calloc in main failed");
+	    if (stream)
+		stream_mm_traces(num_tracefiles, tracefiles, policy_stats[p],
+				 &ranges);
+	    else
+		eval_mm_traces(num_tracefiles, tracefiles, policy_stats[p],
+			       &ranges);
+	    if (verbose) {
+		printf("\nResults for mm malloc, %s policy:\n", policy_names[p]);
+		printresults(num_tracefiles, policy_stats[p]);
+	    }
 	}
-	free_trace(trace);
+	printpolicies(num_tracefiles, policy_stats);
+	mm_stats = policy_stats[MM_POLICY_FIRST_FIT];
     }
+    else {
+	if (policy >= 0 && !mm_setopt(MM_OPT_POLICY, policy))
+	    app_error("mm_setopt(MM_OPT_POLICY) failed");
 
-    /* Display the mm results in a compact table */
-    if (verbose) {
-	printf("\nResults for mm malloc:\n");
-	printresults(num_tracefiles, mm_stats);
-	printf("\n");
+	/* Allocate the mm stats array, with one stats_t struct per tracefile */
+	mm_stats = (stats_t *)calloc(num_tracefiles, sizeof(stats_t));
+	if (mm_stats == NULL)
+	    unix_error("mm_stats calloc in main failed");
+
+	if (stream)
+	    stream_mm_traces(num_tracefiles, tracefiles, mm_stats, &ranges);
+	else
+	    eval_mm_traces(num_tracefiles, tracefiles, mm_stats, &ranges);
+
+	/* Display the mm results in a compact table */
+	if (verbose) {
+	    printf("\nResults for mm malloc:\n");
+	    printresults(num_tracefiles, mm_stats);
+	    if (stream)
+		printstalls(num_tracefiles, mm_stats);
+	    else
+		printtiming(num_tracefiles, mm_stats);
+	    printreallocs(num_tracefiles, mm_stats);
+	    printthreads(num_tracefiles, mm_stats);
+	    printheap(num_tracefiles, mm_stats);
+	    printf("\n");
+	}
     }
 
+    if (profile)
+	printprofile(num_tracefiles, mm_stats);
+
     /*
      * Accumulate the aggregate statistics for the student's mm package
      */
@@ -375,48 +759,507 @@ int main(int argc, char **argv)
 }
 
 
+/*
+ * eval_mm_traces - Evaluate student's mm malloc package on every trace
+ *     using the K-best scheme
+ */
+static void eval_mm_traces(int num_tracefiles, char **tracefiles,
+			   stats_t *mm_stats, range_t **ranges)
+{
+    int i;
+    trace_t *trace;
+    speed_t speed_params;
+
+    for (i=0; i < num_tracefiles; i++) {
+	trace = read_trace(tracedir, tracefiles[i]);
+	mm_stats[i].ops = trace->num_ops;
+	if (verbose > 1)
+	    printf("Checking mm_malloc for correctness, ");
+	/* With -s, the package checks the sizes only while it is checked */
+	if (sized && !mm_setopt(MM_OPT_CHECK_SIZE, 1))
+	    app_error("mm_setopt(MM_OPT_CHECK_SIZE) failed");
+	mm_stats[i].valid = eval_mm_valid(trace, i, ranges, &mm_stats[i]);
+	mm_setopt(MM_OPT_CHECK_SIZE, 0);
+	if (mm_stats[i].valid) {
+	    if (verbose > 1)
+		printf("efficiency, ");
+	    mm_stats[i].util = eval_mm_util(trace, i, ranges, &mm_stats[i]);
+	    speed_params.trace = trace;
+	    speed_params.ranges = *ranges;
+	    if (verbose > 1)
+		printf("and performance.\n");
+	    if (num_threads) {
+		start_replay(&speed_params, trace, 0);
+		mm_stats[i].secs = fsecs(eval_speed_mt, &speed_params);
+		fsecs_last(&mm_stats[i].timing);
+		replay_latency(&speed_params, &mm_stats[i]);
+		stop_replay(&speed_params);
+	    }
+	    else {
+		mm_stats[i].secs = fsecs(eval_mm_speed, &speed_params);
+		fsecs_last(&mm_stats[i].timing);
+	    }
+	    if (profile)
+		profile_percentiles(&mm_stats[i]);
+	}
+	free_trace(trace);
+    }
+}
+
+
+/*****************************************************************
+ * The following routines replay a trace while it is read (-S), for
+ * traces too large to hold in memory. A reader thread fills one of
+ * two buffers of requests while the replay drains the other, and the
+ * blocks are found by id in a table of pages (idtable_t). Each trace
+ * is streamed twice: once to check the blocks and measure the
+ * utilization, once to time the package.
+ ****************************************************************/
+
+/*
+ * stream_mm_traces - Evaluate the mm package on each trace, streaming it
+ */
+static void stream_mm_traces(int num_tracefiles, char **tracefiles,
+			     stats_t *mm_stats, range_t **ranges)
+{
+    int i;
+    char path[MAXLINE];
+
+    for (i=0; i < num_tracefiles; i++) {
+	strcpy(path, tracedir);
+	strcat(path, tracefiles[i]);
+	if (verbose > 1)
+	    printf("Streaming tracefile: %s\nChecking mm_malloc for "
+		   "correctness and efficiency, ", path);
+	if (sized && !mm_setopt(MM_OPT_CHECK_SIZE, 1))
+	    app_error("mm_setopt(MM_OPT_CHECK_SIZE) failed");
+	mm_stats[i].valid = stream_mm(path, i, 1, ranges, &mm_stats[i]);
+	mm_setopt(MM_OPT_CHECK_SIZE, 0);
+	if (mm_stats[i].valid) {
+	    if (verbose > 1)
+		printf("and performance.\n");
+	    stream_mm(path, i, 0, ranges, &mm_stats[i]);
+	    if (profile)
+		profile_percentiles(&mm_stats[i]);
+	}
+    }
+}
+
+/*
+ * stream_mm - Replay the trace in path once with the mm package. If
+ *     checked, check every block and record the utilization, else record
+ *     the time the package needed, less the time spent waiting for the
+ *     reader. Return 0 if the package failed.
+ */
+static int stream_mm(char *path, int tracenum, int checked, range_t **ranges,
+		     stats_t *stats)
+{
+    stream_t s;
+    idtable_t ids;
+    idslot_t *slot;
+    traceop_t *op;
+    char *p, *oldp;
+    size_t k, oldsize, total_size = 0, max_total_size = 0;
+    double start, stall = 0;
+    int b = 0, n, i, j = 0, opnum = 0, valid = 1;
+
+    /* Reset the heap and the range list, and start reading */
+    mem_reset_brk();
+    if (checked) {
+	clear_ranges(ranges);
+	stats->reallocs = 0;
+	stats->inplace = 0;
+    }
+    if (mm_init() < 0) {
+	malloc_error(tracenum, 0, "mm_init failed.");
+	return 0;
+    }
+    open_stream(&s, path);
+    ids.num_pages = (s.num_ids + ID_PAGE - 1) / ID_PAGE;
+    if ((ids.pages = calloc(ids.num_pages, sizeof(idslot_t *))) == NULL ||
+	(ids.live = calloc(ids.num_pages, sizeof(int))) == NULL)
+	unix_error("calloc failed in stream_mm");
+
+    start = now();
+    do {
+	n = next_chunk(&s, b, &stall);
+	for (i = 0; i < n && valid; i++, opnum++) {
+	    op = &s.buf[b][i];
+	    slot = id_get(&ids, op->index);
+	    oldp = slot->p;
+	    oldsize = slot->size;
+
+	    switch (op->type) {
+
+	    case ALLOC: /* mm_malloc */
+		if (op->align)
+		    p = mm_memalign(op->align, op->size);
+		else
+		    p = mm_malloc(op->size);
+		if (p == NULL) {
+		    malloc_error(tracenum, opnum, "mm_malloc failed.");
+		    valid = 0;
+		}
+		else if (checked &&
+			 !add_range(ranges, p, op->size, op->align, tracenum, opnum))
+		    valid = 0;
+		else {
+		    if (checked) /* for the check of a later realloc */
+			memset(p, op->index & 0xFF, op->size);
+		    id_put(&ids, op->index, p, op->size);
+		    total_size += op->size;
+		}
+		break;
+
+	    case REALLOC: /* mm_realloc */
+		if ((p = mm_realloc(oldp, op->size)) == NULL) {
+		    malloc_error(tracenum, opnum, "mm_realloc failed.");
+		    valid = 0;
+		    break;
+		}
+		if (checked) {
+		    stats->reallocs++;
+		    if (p == oldp)
+			stats->inplace++;
+		    if (oldp)
+			remove_range(ranges, oldp);
+		    if (!add_range(ranges, p, op->size, 0, tracenum, opnum)) {
+			valid = 0;
+			break;
+		    }
+
+		    /* The new block holds the data of the old one */
+		    for (k = 0; k < oldsize && k < op->size; k++)
+			if ((unsigned char)p[k] != (op->index & 0xFF)) {
+			    malloc_error(tracenum, opnum, "mm_realloc did not "
+					 "preserve the data from old block");
+			    valid = 0;
+			    break;
+			}
+		    if (!valid)
+			break;
+		    memset(p, op->index & 0xFF, op->size);
+		}
+		id_put(&ids, op->index, p, op->size);
+		total_size += op->size - oldsize;
+		break;
+
+	    case FREE: /* mm_free */
+		if (checked && oldp)
+		    remove_range(ranges, oldp);
+		if (sized)
+		    mm_free_sized(oldp, oldsize);
+		else
+		    mm_free(oldp);
+		id_put(&ids, op->index, NULL, 0);
+		total_size -= oldsize;
+		break;
+
+	    default:
+		app_error("Nonexistent request type in stream_mm");
+	    }
+	    max_total_size = (total_size > max_total_size) ?
+		total_size : max_total_size;
+
+	    /* Sample the heap after each quarter of the requests */
+	    while (checked && j < HEAP_SAMPLES &&
+		   ((double)opnum + 1) * HEAP_SAMPLES >= (j + 1.0) * s.num_ops) {
+		stats->heap[j] = mem_heapsize();
+		stats->resident[j] = mem_resident();
+		j++;
+	    }
+	}
+	done_chunk(&s, b);
+	b ^= 1;
+    } while (n == STREAM_CHUNK && valid);
+
+    if (valid) {
+	stats->ops = opnum;
+	if (checked) {
+	    stats->heap_peak = mem_peak_heapsize();
+	    stats->util = (double)max_total_size / (double)mem_peak_heapsize();
+	}
+	else {
+	    stats->secs = now() - start - stall;
+	    stats->stall = stall;
+	    stats->timing.runs = 1;
+	    stats->timing.reps = 1;
+	    stats->timing.min = stats->secs;
+	    stats->timing.median = stats->secs;
+	    stats->timing.mean = stats->secs;
+	    stats->timing.ci95 = 0;
+	}
+    }
+
+    close_stream(&s);
+    for (i = 0; i < ids.num_pages; i++)
+	free(ids.pages[i]);
+    free(ids.pages);
+    free(ids.live);
+    return valid;
+}
+
+/*
+ * open_stream - Open the trace in path, read its header and start the
+ *     reader thread
+ */
+static void open_stream(stream_t *s, char *path)
+{
+    trace_hdr_t hdr;
+    int ignore = 0;
+
+    s->path = path;
+    if ((s->file = fopen(path, "r")) == NULL) {
+	sprintf(msg, "Could not open %s in open_stream", path);
+	unix_error(msg);
+    }
+    if (fread(&hdr, sizeof(hdr), 1, s->file) != 1)
+	memset(&hdr, 0, sizeof(hdr)); /* a short text trace */
+    if (!memcmp(hdr.magic, CAPTURE_MAGIC, sizeof(hdr.magic))) {
+	printf("Capture log %s must be converted (-c) to be streamed\n", path);
+	exit(1);
+    }
+    if (!memcmp(hdr.magic, TRACE_MAGIC, sizeof(hdr.magic))) {
+	s->binary = 1;
+	s->num_ids = hdr.num_ids;
+	s->num_ops = hdr.num_ops;
+    }
+    else {
+	s->binary = 0;
+	rewind(s->file);
+	ignore += fscanf(s->file, "%*d %d %d %*d", &s->num_ids, &s->num_ops);
+    }
+    if (s->num_ids <= 0 || s->num_ops < 0) {
+	printf("Bogus header in tracefile %s\n", path);
+	exit(1);
+    }
+
+    s->read = 0;
+    s->quit = 0;
+    s->count[0] = s->count[1] = -1;
+    if ((s->buf[0] = malloc(2 * STREAM_CHUNK * sizeof(traceop_t))) == NULL)
+	unix_error("malloc failed in open_stream");
+    s->buf[1] = s->buf[0] + STREAM_CHUNK;
+    pthread_mutex_init(&s->lock, NULL);
+    pthread_cond_init(&s->cond, NULL);
+    if (pthread_create(&s->thread, NULL, stream_reader, s) != 0)
+	unix_error("pthread_create failed in open_stream");
+}
+
+/*
+ * close_stream - Stop the reader thread, if the replay did not drain the
+ *     whole trace, and close the trace
+ */
+static void close_stream(stream_t *s)
+{
+    pthread_mutex_lock(&s->lock);
+    s->quit = 1;
+    pthread_cond_broadcast(&s->cond);
+    pthread_mutex_unlock(&s->lock);
+    pthread_join(s->thread, NULL);
+    pthread_cond_destroy(&s->cond);
+    pthread_mutex_destroy(&s->lock);
+    free(s->buf[0]);
+    fclose(s->file);
+}
+
+/*
+ * stream_reader - The reader thread: fill the two buffers in turn, each
+ *     once the replay has emptied it. A buffer that is not full is the
+ *     last one.
+ */
+static void *stream_reader(void *ptr)
+{
+    stream_t *s = (stream_t *)ptr;
+    int b = 0, n, quit;
+
+    do {
+	pthread_mutex_lock(&s->lock);
+	while (s->count[b] >= 0 && !s->quit)
+	    pthread_cond_wait(&s->cond, &s->lock);
+	quit = s->quit;
+	pthread_mutex_unlock(&s->lock);
+	if (quit)
+	    break;
+
+	n = read_chunk(s, s->buf[b]);
+	pthread_mutex_lock(&s->lock);
+	s->count[b] = n;
+	pthread_cond_broadcast(&s->cond);
+	pthread_mutex_unlock(&s->lock);
+	b ^= 1;
+    } while (n == STREAM_CHUNK);
+    return NULL;
+}
+
+/*
+ * read_chunk - Read the next STREAM_CHUNK requests of the trace into buf,
+ *     fewer at its end; return how many
+ */
+static int read_chunk(stream_t *s, traceop_t *buf)
+{
+    int n, i;
+
+    if (s->binary) {
+	n = fread(buf, sizeof(traceop_t), STREAM_CHUNK, s->file);
+	for (i = 0; i < n; i++)
+	    if (bad_op(&buf[i], s->num_ids)) {
+		printf("Bogus record %d in binary tracefile %s\n",
+		       s->read + i, s->path);
+		exit(1);
+	    }
+    }
+    else
+	for (n = 0; n < STREAM_CHUNK; n++)
+	    if (!parse_op(s->file, &buf[n], s->path, s->read + n))
+		break;
+	    else if (bad_op(&buf[n], s->num_ids)) {
+		printf("Bogus request %d in tracefile %s\n",
+		       s->read + n, s->path);
+		exit(1);
+	    }
+    s->read += n;
+
+    if (n < STREAM_CHUNK && s->read != s->num_ops) {
+	printf("Tracefile %s holds %d requests, its header says %d\n",
+	       s->path, s->read, s->num_ops);
+	exit(1);
+    }
+    return n;
+}
+
+/*
+ * next_chunk - Wait until the reader has filled buffer b; return the
+ *     number of requests in it and add the time waited to *stall
+ */
+static int next_chunk(stream_t *s, int b, double *stall)
+{
+    double start;
+    int n;
+
+    pthread_mutex_lock(&s->lock);
+    if (s->count[b] < 0) {
+	start = now();
+	while (s->count[b] < 0)
+	    pthread_cond_wait(&s->cond, &s->lock);
+	*stall += now() - start;
+    }
+    n = s->count[b];
+    pthread_mutex_unlock(&s->lock);
+    return n;
+}
+
+/*
+ * done_chunk - Hand buffer b back to the reader
+ */
+static void done_chunk(stream_t *s, int b)
+{
+    pthread_mutex_lock(&s->lock);
+    s->count[b] = -1;
+    pthread_cond_broadcast(&s->cond);
+    pthread_mutex_unlock(&s->lock);
+}
+
+/*
+ * id_get - The slot of an id, on a page allocated if it has none
+ */
+static idslot_t *id_get(idtable_t *t, int index)
+{
+    idslot_t **page = &t->pages[index / ID_PAGE];
+
+    if (*page == NULL && (*page = calloc(ID_PAGE, sizeof(idslot_t))) == NULL)
+	unix_error("calloc failed in id_get");
+    return &(*page)[index % ID_PAGE];
+}
+
+/*
+ * id_put - Record the block of an id (NULL when it was freed), and free
+ *     its page when no block is left on it
+ */
+static void id_put(idtable_t *t, int index, char *p, size_t size)
+{
+    int pg = index / ID_PAGE;
+    idslot_t *slot = &t->pages[pg][index % ID_PAGE];
+
+    t->live[pg] += (p != NULL) - (slot->p != NULL);
+    slot->p = p;
+    slot->size = size;
+    if (t->live[pg] == 0) {
+	free(t->pages[pg]);
+	t->pages[pg] = NULL;
+    }
+}
+
+/*
+ * now - seconds on the monotonic clock
+ */
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1E-9 * ts.tv_nsec;
+}
+
+
 /*****************************************************************
- * The following routines manipulate the range list, which keeps
+ * The following routines manipulate the range tree, which keeps
  * track of the extent of every allocated block payload. We use the
- * range list to detect any overlapping allocated blocks.
+ * range tree to detect any overlapping allocated blocks. It is a
+ * treap: a search tree by address, with random priorities that keep
+ * it balanced in expectation, so each operation takes O(log n).
  ****************************************************************/
 
 /*
  * add_range - As directed by request opnum in trace tracenum,
  *     we've just called the student's mm_malloc to allocate a block of
- *     size bytes at addr lo. After checking the block for correctness,
- *     we create a range struct for this block and add it to the range list.
+ *     size bytes at addr lo, with an alignment of align bytes if the
+ *     request asked for one (0 otherwise). After checking the block for
+ *     correctness, we create a range struct for this block and add it
+ *     to the range tree.
  */
-static int add_range(range_t **ranges, char *lo, int size,
+static int add_range(range_t **ranges, char *lo, size_t size, size_t align,
 		     int tracenum, int opnum)
 {
     char *hi = lo + size - 1;
     range_t *p;
+    int arena, i;
+    void *heap_lo, *heap_hi;
     char msg[MAXLINE];
 
     assert(size > 0);
 
-    /* Payload addresses must be ALIGNMENT-byte aligned */
-    if (!IS_ALIGNED(lo)) {
-	sprintf(msg, "Payload address (%p) not aligned to %d bytes",
-		lo, ALIGNMENT);
+    /* Payload addresses must be ALIGNMENT-byte aligned, or aligned as
+       requested */
+    if (align < ALIGNMENT)
+	align = ALIGNMENT;
+    if (!IS_ALIGNED(lo, align)) {
+	sprintf(msg, "Payload address (%p) not aligned to %zu bytes",
+		lo, align);
         malloc_error(tracenum, opnum, msg);
         return 0;
     }
 
-    /* The payload must lie within the extent of the heap */
-    if ((lo < (char *)mem_heap_lo()) || (lo > (char *)mem_heap_hi()) ||
-	(hi < (char *)mem_heap_lo()) || (hi > (char *)mem_heap_hi())) {
+    /* The payload must lie within the extent of the heap (arena) or the
+       mapping it is in */
+    if ((arena = mem_arena_of(lo)) >= 0 || !mem_mapping_of(lo, &heap_lo, &heap_hi)) {
+	arena = (arena < 0) ? 0 : arena;
+	heap_lo = mem_arena_lo(arena);
+	heap_hi = mem_arena_hi(arena);
+    }
+    if ((lo < (char *)heap_lo) || (lo > (char *)heap_hi) ||
+	(hi < (char *)heap_lo) || (hi > (char *)heap_hi)) {
 	sprintf(msg, "Payload (%p:%p) lies outside heap (%p:%p)",
-		lo, hi, mem_heap_lo(), mem_heap_hi());
+		lo, hi, heap_lo, heap_hi);
 	malloc_error(tracenum, opnum, msg);
         return 0;
     }
 
-    /* The payload must not overlap any other payloads */
-    for (p = *ranges;  p != NULL;  p = p->next) {
-        if ((lo >= p->lo && lo <= p-> hi) ||
-            (hi >= p->lo && hi <= p->hi)) {
+    /* The payload must not overlap any other payloads. The payloads in
+       the tree are disjoint, so if one overlaps, the one starting next
+       below lo or next above it does, and both are on the path to lo */
+    for (p = *ranges;  p != NULL;  p = (lo < p->lo) ? p->left : p->right) {
+        if (lo <= p->hi && hi >= p->lo) {
 	    sprintf(msg, "Payload (%p:%p) overlaps another payload (%p:%p)\n",
 		    lo, hi, p->lo, p->hi);
 	    malloc_error(tracenum, opnum, msg);
@@ -426,17 +1269,80 @@ static int add_range(range_t **ranges, char *lo, int size,
 
     /*
      * Everything looks OK, so remember the extent of this block
-     * by creating a range struct and adding it the range list.
+     * by taking a range struct from the pool and adding it the range
+     * tree.
      */
-    if ((p = (range_t *)malloc(sizeof(range_t))) == NULL)
-	unix_error("malloc error in add_range");
-    p->next = *ranges;
+    if (range_pool == NULL) {
+	if ((p = (range_t *)malloc(RANGE_CHUNK * sizeof(range_t))) == NULL)
+	    unix_error("malloc error in add_range");
+	for (i = 0; i < RANGE_CHUNK; i++) {
+	    p[i].left = range_pool;
+	    range_pool = &p[i];
+	}
+    }
+    p = range_pool;
+    range_pool = p->left;
     p->lo = lo;
     p->hi = hi;
-    *ranges = p;
+    range_seed ^= range_seed << 13; /* xorshift */
+    range_seed ^= range_seed >> 17;
+    range_seed ^= range_seed << 5;
+    p->prio = range_seed;
+    p->left = p->right = NULL;
+    *ranges = insert_range(*ranges, p);
     return 1;
 }
 
+/*
+ * insert_range - Insert the record p into the treap t, return the new
+ *     root: p goes down to a leaf by address, then rotates up past the
+ *     parents with lower priorities
+ */
+static range_t *insert_range(range_t *t, range_t *p)
+{
+    range_t *c;
+
+    if (t == NULL)
+	return p;
+    if (p->lo < t->lo) {
+	t->left = insert_range(t->left, p);
+	if (t->left->prio > t->prio) { /* rotate right */
+	    c = t->left;
+	    t->left = c->right;
+	    c->right = t;
+	    return c;
+	}
+    }
+    else {
+	t->right = insert_range(t->right, p);
+	if (t->right->prio > t->prio) { /* rotate left */
+	    c = t->right;
+	    t->right = c->left;
+	    c->left = t;
+	    return c;
+	}
+    }
+    return t;
+}
+
+/*
+ * join_ranges - Join the treaps a and b, all of a below all of b, and
+ *     return the new root
+ */
+static range_t *join_ranges(range_t *a, range_t *b)
+{
+    if (a == NULL)
+	return b;
+    if (b == NULL)
+	return a;
+    if (a->prio > b->prio) {
+	a->right = join_ranges(a->right, b);
+	return a;
+    }
+    b->left = join_ranges(a, b->left);
+    return b;
+}
+
 /*
  * remove_range - Free the range record of block whose payload starts at lo
  */
@@ -444,16 +1350,15 @@ static void remove_range(range_t **ranges, char *lo)
 {
     range_t *p;
     range_t **prevpp = ranges;
-    /* int size; */
 
-    for (p = *ranges;  p != NULL; p = p->next) {
+    for (p = *ranges;  p != NULL;  p = *prevpp) {
         if (p->lo == lo) {
-	    *prevpp = p->next;
-            /* size = p->hi - p->lo + 1; */
-            free(p);
+	    *prevpp = join_ranges(p->left, p->right);
+	    p->left = range_pool;
+	    range_pool = p;
             break;
         }
-        prevpp = &(p->next);
+        prevpp = (lo < p->lo) ? &p->left : &p->right;
     }
 }
 
@@ -463,13 +1368,20 @@ static void remove_range(range_t **ranges, char *lo)
 static void clear_ranges(range_t **ranges)
 {
     range_t *p;
-    range_t *pnext;
 
-    for (p = *ranges;  p != NULL;  p = pnext) {
-        pnext = p->next;
-        free(p);
+    /* Flatten the tree: rotate left children up until there are none */
+    while ((p = *ranges) != NULL) {
+	if (p->left != NULL) {
+	    *ranges = p->left;
+	    p->left = (*ranges)->right;
+	    (*ranges)->right = p;
+	}
+	else {
+	    *ranges = p->right;
+	    p->left = range_pool;
+	    range_pool = p;
+	}
     }
-    *ranges = NULL;
 }
 
 
@@ -484,9 +1396,8 @@ static trace_t *read_trace(char *tracedir, char *filename)
 {
     FILE *tracefile;
     trace_t *trace;
-    char type[MAXLINE];
     char path[MAXLINE];
-    unsigned index, size;
+    unsigned index;
     unsigned max_index = 0;
     unsigned op_index;
     int ignore = 0;
@@ -505,6 +1416,13 @@ static trace_t *read_trace(char *tracedir, char *filename)
 	sprintf(msg, "Could not open %s in read_trace", path);
 	unix_error(msg);
     }
+    if (map_trace(trace, tracefile, path) ||
+	load_capture(trace, tracefile, path)) {
+	fclose(tracefile);
+	return trace;
+    }
+    trace->map = NULL;
+    trace->map_len = 0;
     ignore += fscanf(tracefile, "%d", &(trace->sugg_heapsize)); /* not used */
     ignore += fscanf(tracefile, "%d", &(trace->num_ids));
     ignore += fscanf(tracefile, "%d", &(trace->num_ops));
@@ -526,29 +1444,16 @@ static trace_t *read_trace(char *tracedir, char *filename)
 	unix_error("malloc 4 failed in read_trace");
 
     /* read every request line in the trace file */
-    index = 0;
     op_index = 0;
-    while (fscanf(tracefile, "%s", type) != EOF) {
-	switch(type[0]) {
-	case 'a':
-	    ignore += fscanf(tracefile, "%u %u", &index, &size);
-	    trace->ops[op_index].type = ALLOC;
-	    trace->ops[op_index].index = index;
-	    trace->ops[op_index].size = size;
+    while (parse_op(tracefile, &trace->ops[op_index], path, op_index)) {
+	index = trace->ops[op_index].index;
+	if (trace->ops[op_index].type == FREE)
+	    trace->ops[op_index].size = trace->block_sizes[index]; /* for -s */
+	else {
+	    trace->block_sizes[index] = trace->ops[op_index].size;
 	    max_index = (index > max_index) ? index : max_index;
-	    break;
-	case 'f':
-	    ignore += fscanf(tracefile, "%ud", &index);
-	    trace->ops[op_index].type = FREE;
-	    trace->ops[op_index].index = index;
-	    break;
-	default:
-	    printf("Bogus type character (%c) in tracefile %s\n",
-		   type[0], path);
-	    exit(1);
 	}
 	op_index++;
-
     }
     fclose(tracefile);
     assert(max_index == trace->num_ids - 1);
@@ -558,14 +1463,269 @@ static trace_t *read_trace(char *tracedir, char *filename)
 }
 
 /*
- * free_trace - Free the trace record and the three arrays it points
- *              to, all of which were allocated in read_trace().
+ * parse_op - Read request op_index of a text trace into op; return 0 at
+ *     the end of the file. The size of a free is left 0.
  */
-void free_trace(trace_t *trace)
+static int parse_op(FILE *tracefile, traceop_t *op, char *path,
+		    unsigned op_index)
 {
-    free(trace->ops);         /* free the three arrays... */
-    free(trace->blocks);
-    free(trace->block_sizes);
+    char type[MAXLINE];
+    unsigned index;
+    size_t size, align;
+    int ignore = 0;
+
+    if (fscanf(tracefile, "%s", type) == EOF)
+	return 0;
+    switch(type[0]) {
+    case 'a':
+	ignore += fscanf(tracefile, "%u %zu", &index, &size);
+	op->type = ALLOC;
+	op->index = index;
+	op->size = size;
+	op->align = 0;
+	break;
+    case 'm':
+	ignore += fscanf(tracefile, "%u %zu %zu", &index, &size, &align);
+	if (align == 0 || (align & (align - 1)) != 0) {
+	    printf("Alignment %zu of request %u is not a power of two "
+		   "in tracefile %s\n", align, op_index, path);
+	    exit(1);
+	}
+	op->type = ALLOC;
+	op->index = index;
+	op->size = size;
+	op->align = align;
+	break;
+    case 'r':
+	ignore += fscanf(tracefile, "%u %zu", &index, &size);
+	op->type = REALLOC;
+	op->index = index;
+	op->size = size;
+	op->align = 0;
+	break;
+    case 'f':
+	ignore += fscanf(tracefile, "%ud", &index);
+	op->type = FREE;
+	op->index = index;
+	op->size = 0;
+	op->align = 0;
+	break;
+    default:
+	printf("Bogus type character (%c) in tracefile %s\n",
+	       type[0], path);
+	exit(1);
+    }
+    return 1;
+}
+
+/*
+ * bad_op - Is op no valid request of a trace with num_ids ids?
+ */
+static int bad_op(traceop_t *op, int num_ids)
+{
+    return op->index < 0 || op->index >= num_ids ||
+	(op->type != ALLOC && op->type != FREE && op->type != REALLOC) ||
+	(op->type != ALLOC && op->align != 0) ||
+	(op->align & (op->align - 1)) != 0;
+}
+
+/*
+ * map_trace - If tracefile is a binary trace, map its records into
+ *     memory as the ops of the trace and check them; return 0 for a text
+ *     trace, with the file rewound
+ */
+static int map_trace(trace_t *trace, FILE *tracefile, char *path)
+{
+    trace_hdr_t hdr;
+    struct stat st;
+
+    if (fread(&hdr, sizeof(hdr), 1, tracefile) != 1 ||
+	memcmp(hdr.magic, TRACE_MAGIC, sizeof(hdr.magic))) {
+	rewind(tracefile);
+	return 0;
+    }
+    if (fstat(fileno(tracefile), &st) < 0)
+	unix_error("fstat failed in map_trace");
+    if (hdr.num_ids <= 0 || hdr.num_ops < 0 ||
+	(size_t)st.st_size != sizeof(hdr) + hdr.num_ops * sizeof(trace_rec_t)) {
+	printf("Header of binary tracefile %s does not match its size\n", path);
+	exit(1);
+    }
+    trace->sugg_heapsize = hdr.sugg_heapsize;
+    trace->num_ids = hdr.num_ids;
+    trace->num_ops = hdr.num_ops;
+    trace->weight = hdr.weight;
+
+    /* The records are replayed where the page cache has them */
+    trace->map_len = st.st_size;
+    trace->map = mmap(NULL, trace->map_len, PROT_READ, MAP_PRIVATE,
+		      fileno(tracefile), 0);
+    if (trace->map == MAP_FAILED)
+	unix_error("mmap failed in map_trace");
+    trace->ops = (traceop_t *)((char *)trace->map + sizeof(hdr));
+    check_trace(trace, path);
+    return 1;
+}
+
+/*
+ * load_capture - If tracefile is a capture log (capture.c), read its
+ *     records into the ops of the trace in the order of their sequence
+ *     numbers and check them; return 0 for any other file, rewound
+ */
+static int load_capture(trace_t *trace, FILE *tracefile, char *path)
+{
+    char magic[8];
+    struct stat st;
+    capture_rec_t *recs;
+    char *live;
+    size_t n, i;
+    int dropped = 0;
+
+    if (fread(magic, sizeof(magic), 1, tracefile) != 1 ||
+	memcmp(magic, CAPTURE_MAGIC, sizeof(magic))) {
+	rewind(tracefile);
+	return 0;
+    }
+    if (fstat(fileno(tracefile), &st) < 0)
+	unix_error("fstat failed in load_capture");
+    n = (st.st_size - sizeof(magic)) / sizeof(capture_rec_t); /* a crash
+					    may have cut the last record */
+    if (n == 0 || n > INT_MAX) {
+	printf("Capture log %s holds no trace mdriver can replay\n", path);
+	exit(1);
+    }
+    if ((recs = (capture_rec_t *)malloc(n * sizeof(capture_rec_t))) == NULL ||
+	(trace->ops = (traceop_t *)malloc(n * sizeof(traceop_t))) == NULL)
+	unix_error("malloc failed in load_capture");
+    if (fread(recs, sizeof(capture_rec_t), n, tracefile) != n)
+	unix_error("fread failed in load_capture");
+    qsort(recs, n, sizeof(capture_rec_t), cmp_seq);
+
+    /* A corrupt log must not index live[] out of bounds */
+    trace->num_ids = 0;
+    for (i = 0; i < n; i++) {
+	if (bad_op((traceop_t *)&recs[i].rec, INT_MAX) ||
+	    (recs[i].rec.type != FREE && recs[i].rec.size == 0)) {
+	    printf("Bogus record %zu in capture log %s\n", i, path);
+	    exit(1);
+	}
+	if (recs[i].rec.index >= trace->num_ids)
+	    trace->num_ids = recs[i].rec.index + 1;
+    }
+    if ((live = (char *)calloc(trace->num_ids, 1)) == NULL)
+	unix_error("calloc failed in load_capture");
+
+    /* Drop the requests on blocks whose allocation the log lost */
+    trace->num_ops = 0;
+    for (i = 0; i < n; i++) {
+	if (recs[i].rec.type != ALLOC && !live[recs[i].rec.index]) {
+	    dropped++;
+	    continue;
+	}
+	live[recs[i].rec.index] = (recs[i].rec.type != FREE);
+	memcpy(&trace->ops[trace->num_ops++], &recs[i].rec, sizeof(traceop_t));
+    }
+    if (dropped)
+	printf("Dropped %d requests of %s on blocks the log lost\n",
+	       dropped, path);
+    free(recs);
+    free(live);
+
+    trace->sugg_heapsize = 0;
+    trace->weight = 1;
+    trace->map = NULL;
+    trace->map_len = 0;
+    check_trace(trace, path);
+    return 1;
+}
+
+/*
+ * cmp_seq - qsort comparison for capture records in sequence order
+ */
+static int cmp_seq(const void *a, const void *b)
+{
+    uint64_t x = ((const capture_rec_t *)a)->seq;
+    uint64_t y = ((const capture_rec_t *)b)->seq;
+
+    return (x > y) - (x < y);
+}
+
+/*
+ * check_trace - Allocate the block arrays of a binary trace or capture
+ *     log, and check its requests: the replay trusts their ids,
+ *     alignments, that frees and reallocs name a live block, and the
+ *     sizes of frees (-s)
+ */
+static void check_trace(trace_t *trace, char *path)
+{
+    traceop_t *op;
+    char *live;
+    int i;
+
+    if ((trace->blocks =
+	 (char **)malloc(trace->num_ids * sizeof(char *))) == NULL)
+	unix_error("malloc 1 failed in check_trace");
+    if ((trace->block_sizes =
+	 (size_t *)calloc(trace->num_ids, sizeof(size_t))) == NULL)
+	unix_error("malloc 2 failed in check_trace");
+    if ((live = (char *)calloc(trace->num_ids, 1)) == NULL)
+	unix_error("calloc failed in check_trace");
+
+    for (i = 0; i < trace->num_ops; i++) {
+	op = &trace->ops[i];
+	if (bad_op(op, trace->num_ids) ||
+	    (op->type != ALLOC && !live[op->index]) ||
+	    (op->type == FREE && op->size != trace->block_sizes[op->index])) {
+	    printf("Bogus record %d in binary tracefile %s\n", i, path);
+	    exit(1);
+	}
+	live[op->index] = (op->type != FREE);
+	if (op->type != FREE)
+	    trace->block_sizes[op->index] = op->size;
+    }
+    free(live);
+}
+
+/*
+ * write_trace - Write trace to path in the binary format
+ */
+static void write_trace(trace_t *trace, char *path)
+{
+    FILE *out;
+    trace_hdr_t hdr;
+
+    memcpy(hdr.magic, TRACE_MAGIC, sizeof(hdr.magic));
+    hdr.sugg_heapsize = trace->sugg_heapsize;
+    hdr.num_ids = trace->num_ids;
+    hdr.num_ops = trace->num_ops;
+    hdr.weight = trace->weight;
+
+    if ((out = fopen(path, "w")) == NULL) {
+	sprintf(msg, "Could not create %s in write_trace", path);
+	unix_error(msg);
+    }
+    if (fwrite(&hdr, sizeof(hdr), 1, out) != 1 ||
+	fwrite(trace->ops, sizeof(traceop_t), trace->num_ops, out) !=
+	(size_t)trace->num_ops ||
+	fclose(out) != 0) {
+	sprintf(msg, "Could not write %s in write_trace", path);
+	unix_error(msg);
+    }
+}
+
+/*
+ * free_trace - Free the trace record and the three arrays it points
+ *              to (unmap the records of a binary trace instead of
+ *              freeing them).
+ */
+void free_trace(trace_t *trace)
+{
+    if (trace->map)           /* unmap the records of a binary trace, */
+	munmap(trace->map, trace->map_len);
+    else                      /* or free the three arrays... */
+	free(trace->ops);
+    free(trace->blocks);
+    free(trace->block_sizes);
     free(trace);              /* and the trace record itself... */
 }
 
@@ -577,34 +1737,57 @@ void free_trace(trace_t *trace)
 /*
  * eval_mm_valid - Check the mm malloc package for correctness
  */
-static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
+static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges,
+			 stats_t *stats)
 {
-    int i;
+    int i, n;
     int index;
-    int size;
-    char *p;
+    int batched = 0; /* requests before this one were done by a batch */
+    size_t j;
+    size_t size;
+    size_t oldsize;
+    char *p, *newp, *oldp;
 
     /* Reset the heap and free any records in the range list */
     mem_reset_brk();
     clear_ranges(ranges);
+    stats->reallocs = 0;
+    stats->inplace = 0;
 
     /* Call the mm package's init function */
     if (mm_init() < 0) {
 	malloc_error(tracenum, 0, "mm_init failed.");
 	return 0;
     }
-
     /* Interpret each operation in the trace in order */
     for (i = 0;  i < trace->num_ops;  i++) {
 	index = trace->ops[i].index;
 	size = trace->ops[i].size;
 
+	/*
+	 * With -b, a run of requests is done by one batch call at its
+	 * first request; the blocks are still checked one request at a time
+	 */
+	if (batch && i >= batched) {
+	    if ((n = batch_run(trace, i)) < 0) {
+		malloc_error(tracenum, i, "mm_malloc_batch failed.");
+		return 0;
+	    }
+	    batched = i + n;
+	}
+
         switch (trace->ops[i].type) {
 
         case ALLOC: /* mm_malloc */
 
-	    /* Call the student's malloc */
-	    if ((p = mm_malloc(size)) == NULL) {
+	    /* Call the student's malloc (or memalign) */
+	    if (i < batched)
+		p = trace->blocks[index];
+	    else if (trace->ops[i].align)
+		p = mm_memalign(trace->ops[i].align, size);
+	    else
+		p = mm_malloc(size);
+	    if (p == NULL) {
 		malloc_error(tracenum, i, "mm_malloc failed.");
 		return 0;
 	    }
@@ -614,7 +1797,7 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 	     * to the range list if OK. The block must be  be aligned properly,
 	     * and must not overlap any currently allocated block.
 	     */
-	    if (add_range(ranges, p, size, tracenum, i) == 0)
+	    if (add_range(ranges, p, size, trace->ops[i].align, tracenum, i) == 0)
 		return 0;
 
 	    /* ADDED: cgw
@@ -629,12 +1812,58 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 	    trace->block_sizes[index] = size;
 	    break;
 
+        case REALLOC: /* mm_realloc */
+
+	    /* Call the student's realloc */
+	    oldp = trace->blocks[index];
+	    if ((newp = mm_realloc(oldp, size)) == NULL) {
+		malloc_error(tracenum, i, "mm_realloc failed.");
+		return 0;
+	    }
+	    stats->reallocs++;
+	    if (newp == oldp)
+		stats->inplace++;
+
+	    /* Remove the old region from the range list */
+	    remove_range(ranges, oldp);
+
+	    /* Check new block for correctness and add it to range list */
+	    if (add_range(ranges, newp, size, 0, tracenum, i) == 0)
+		return 0;
+
+	    /* ADDED: cgw
+	     * Make sure that the new block contains the data from the old
+	     * block and then fill in the new block with the low order byte
+	     * of the new index
+	     */
+	    oldsize = trace->block_sizes[index];
+	    if (size < oldsize)
+		oldsize = size;
+	    for (j = 0; j < oldsize; j++) {
+		if ((unsigned char)newp[j] != (index & 0xFF)) {
+		    malloc_error(tracenum, i, "mm_realloc did not preserve the "
+				 "data from old block");
+		    return 0;
+		}
+	    }
+	    memset(newp, index & 0xFF, size);
+
+	    /* Remember region */
+	    trace->blocks[index] = newp;
+	    trace->block_sizes[index] = size;
+	    break;
+
         case FREE: /* mm_free */
 
 	    /* Remove region from list and call student's free function */
 	    p = trace->blocks[index];
 	    remove_range(ranges, p);
-	    mm_free(p);
+	    if (i < batched)
+		break;
+	    if (sized)
+		mm_free_sized(p, trace->block_sizes[index]);
+	    else
+		mm_free(p);
 	    break;
 
 	default:
@@ -652,20 +1881,22 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
  *   The idea is to remember the high water mark "hwm" of the heap for
  *   an optimal allocator, i.e., no gaps and no internal fragmentation.
  *   Utilization is the ratio hwm/heapsize, where heapsize is the
- *   size of the heap in bytes after running the student's malloc
- *   package on the trace. Note that our implementation of mem_sbrk()
- *   doesn't allow the students to decrement the brk pointer, so brk
- *   is always the high water mark of the heap.
+ *   high water mark of the brk pointer while running the student's
+ *   malloc package on the trace (mem_sbrk() can decrement the brk, so
+ *   the final heap may be smaller). The size of the heap and how much
+ *   of it is resident are sampled in stats after each quarter of the
+ *   requests.
  *
  */
-static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
+static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges,
+			   stats_t *stats)
 {
-    int i;
+    int i, j = 0;
     int index;
-    int size;
-    int max_total_size = 0;
-    int total_size = 0;
-    char *p;
+    size_t size, newsize, oldsize;
+    size_t max_total_size = 0;
+    size_t total_size = 0;
+    char *p, *newp, *oldp;
 
     /* initialize the heap and the mm malloc package */
     mem_reset_brk();
@@ -679,7 +1910,11 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
 	    index = trace->ops[i].index;
 	    size = trace->ops[i].size;
 
-	    if ((p = mm_malloc(size)) == NULL)
+	    if (trace->ops[i].align)
+		p = mm_memalign(trace->ops[i].align, size);
+	    else
+		p = mm_malloc(size);
+	    if (p == NULL)
 		app_error("mm_malloc failed in eval_mm_util");
 
 	    /* Remember region and size */
@@ -695,6 +1930,28 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
 		total_size : max_total_size;
 	    break;
 
+        case REALLOC: /* mm_realloc */
+	    index = trace->ops[i].index;
+	    newsize = trace->ops[i].size;
+	    oldsize = trace->block_sizes[index];
+
+	    oldp = trace->blocks[index];
+	    if ((newp = mm_realloc(oldp, newsize)) == NULL)
+		app_error("mm_realloc failed in eval_mm_util");
+
+	    /* Remember region and size */
+	    trace->blocks[index] = newp;
+	    trace->block_sizes[index] = newsize;
+
+	    /* Keep track of current total size
+	     * of all allocated blocks */
+	    total_size += (newsize - oldsize);
+
+	    /* Update statistics */
+	    max_total_size = (total_size > max_total_size) ?
+		total_size : max_total_size;
+	    break;
+
         case FREE: /* mm_free */
 	    index = trace->ops[i].index;
 	    size = trace->block_sizes[index];
@@ -712,9 +1969,18 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
 	    app_error("Nonexistent request type in eval_mm_util");
 
         }
+
+	/* Sample the heap after each quarter of the requests */
+	while (j < HEAP_SAMPLES &&
+	       (i + 1) * HEAP_SAMPLES >= (j + 1) * trace->num_ops) {
+	    stats->heap[j] = mem_heapsize();
+	    stats->resident[j] = mem_resident();
+	    j++;
+	}
     }
 
-    return ((double)max_total_size / (double)mem_heapsize());
+    stats->heap_peak = mem_peak_heapsize();
+    return ((double)max_total_size / (double)mem_peak_heapsize());
 }
 
 
@@ -724,8 +1990,9 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
  */
 static void eval_mm_speed(void *ptr)
 {
-    int i, index, size;
-    char *p, *block;
+    int i, n, index;
+    size_t size;
+    char *p, *block, *oldp, *newp;
     trace_t *trace = ((speed_t *)ptr)->trace;
 
     /* Reset the heap and initialize the mm package */
@@ -734,26 +2001,306 @@ static void eval_mm_speed(void *ptr)
 	app_error("mm_init failed in eval_mm_speed");
 
     /* Interpret each trace request */
-    for (i = 0;  i < trace->num_ops;  i++)
+    for (i = 0;  i < trace->num_ops;  i++) {
+	if (batch && (n = batch_run(trace, i)) != 0) {
+	    if (n < 0)
+		app_error("mm_malloc_batch error in eval_mm_speed");
+	    i += n - 1;
+	    continue;
+	}
+
         switch (trace->ops[i].type) {
 
         case ALLOC: /* mm_malloc */
             index = trace->ops[i].index;
             size = trace->ops[i].size;
-            if ((p = mm_malloc(size)) == NULL)
+            if (trace->ops[i].align)
+		p = mm_memalign(trace->ops[i].align, size);
+	    else
+		p = mm_malloc(size);
+            if (p == NULL)
 		app_error("mm_malloc error in eval_mm_speed");
             trace->blocks[index] = p;
             break;
 
+        case REALLOC: /* mm_realloc */
+            index = trace->ops[i].index;
+            size = trace->ops[i].size;
+            oldp = trace->blocks[index];
+            if ((newp = mm_realloc(oldp, size)) == NULL)
+		app_error("mm_realloc error in eval_mm_speed");
+            trace->blocks[index] = newp;
+            break;
+
         case FREE: /* mm_free */
             index = trace->ops[i].index;
             block = trace->blocks[index];
-            mm_free(block);
+            if (sized)
+		mm_free_sized(block, trace->ops[i].size);
+	    else
+		mm_free(block);
             break;
 
 	default:
 	    app_error("Nonexistent request type in eval_mm_valid");
         }
+    }
+}
+
+/*
+ * batch_run - If the requests from opnum on start a run of allocations
+ *     of one size or of frees, do the whole run with one call to
+ *     mm_malloc_batch or mm_free_batch and return its length (the new
+ *     blocks are stored in trace->blocks). Returns 0 for a request that
+ *     has to be done on its own, -1 if mm_malloc_batch failed.
+ */
+static int batch_run(trace_t *trace, int opnum)
+{
+    traceop_t *op = &trace->ops[opnum];
+    void *ptrs[BATCH_MAX];
+    int n, k;
+
+    if (op->type == REALLOC || op->align)
+	return 0;
+    for (n = 1; n < BATCH_MAX && opnum + n < trace->num_ops; n++)
+	if (op[n].type != op->type || op[n].align ||
+	    (op->type == ALLOC && op[n].size != op->size))
+	    break;
+    if (n == 1)
+	return 0;
+
+    if (op->type == ALLOC) {
+	if (mm_malloc_batch(op->size, n, ptrs) < (size_t)n)
+	    return -1;
+	for (k = 0; k < n; k++)
+	    trace->blocks[op[k].index] = ptrs[k];
+    }
+    else {
+	for (k = 0; k < n; k++)
+	    ptrs[k] = trace->blocks[op[k].index];
+	mm_free_batch(ptrs, n);
+    }
+    return n;
+}
+
+/*
+ * start_replay - Set up the concurrent replay of a trace: start
+ *    num_threads threads that wait for eval_speed_mt to release them,
+ *    and number each request within its id so that requests on the same
+ *    id can be ordered across threads.
+ */
+static void start_replay(speed_t *speed, trace_t *trace, int libc)
+{
+    int i, *count;
+    replay_t *r;
+
+    speed->trace = trace;
+    speed->libc = libc;
+    speed->quit = 0;
+
+    if ((speed->seq = (int *)malloc(trace->num_ops * sizeof(int))) == NULL)
+	unix_error("malloc 1 failed in start_replay");
+    if ((speed->done = (int *)calloc(trace->num_ids, sizeof(int))) == NULL)
+	unix_error("malloc 2 failed in start_replay");
+    count = speed->done;
+    for (i = 0; i < trace->num_ops; i++)
+	speed->seq[i] = count[trace->ops[i].index]++;
+
+    if ((speed->threads =
+	 (replay_t *)calloc(num_threads, sizeof(replay_t))) == NULL)
+	unix_error("malloc 3 failed in start_replay");
+    pthread_barrier_init(&speed->start, NULL, num_threads + 1);
+    pthread_barrier_init(&speed->end, NULL, num_threads + 1);
+
+    for (i = 0; i < num_threads; i++) {
+	r = &speed->threads[i];
+	r->speed = speed;
+	r->tid = i;
+	r->blocks = trace->blocks;
+	if (replay_mode == REPLAY_COPIES &&
+	    (r->blocks = (char **)malloc(trace->num_ids * sizeof(char *))) == NULL)
+	    unix_error("malloc 4 failed in start_replay");
+	if (pthread_create(&r->thread, NULL, replay_thread, r) != 0)
+	    app_error("pthread_create failed in start_replay");
+    }
+}
+
+/*
+ * stop_replay - Let the replay threads exit and free what start_replay
+ *    allocated
+ */
+static void stop_replay(speed_t *speed)
+{
+    int i;
+
+    speed->quit = 1;
+    pthread_barrier_wait(&speed->start);
+    for (i = 0; i < num_threads; i++) {
+	pthread_join(speed->threads[i].thread, NULL);
+	if (speed->threads[i].blocks != speed->trace->blocks)
+	    free(speed->threads[i].blocks);
+    }
+    pthread_barrier_destroy(&speed->start);
+    pthread_barrier_destroy(&speed->end);
+    free(speed->threads);
+    free(speed->seq);
+    free(speed->done);
+}
+
+/*
+ * eval_speed_mt - This is the function that is used by fcyc() to
+ *    measure the running time of the concurrent replay: one run of all
+ *    replay threads on a fresh heap.
+ */
+static void eval_speed_mt(void *ptr)
+{
+    speed_t *speed = (speed_t *)ptr;
+
+    memset(speed->done, 0, speed->trace->num_ids * sizeof(int));
+
+    /* Reset the heap and initialize the mm package */
+    if (!speed->libc) {
+	mem_reset_brk();
+	if (mm_init() < 0)
+	    app_error("mm_init failed in eval_speed_mt");
+    }
+
+    pthread_barrier_wait(&speed->start);
+    pthread_barrier_wait(&speed->end);
+}
+
+/*
+ * replay_thread - Body of one replay thread. Per run, it executes the
+ *    requests of the trace that belong to it in trace order. Requests on
+ *    one id may be spread over two threads (xfree mode), so a request
+ *    first waits until all earlier requests on its id have completed.
+ */
+static void *replay_thread(void *ptr)
+{
+    replay_t *r = (replay_t *)ptr;
+    speed_t *speed = r->speed;
+    trace_t *trace;
+    traceop_t *op;
+    struct timespec start, end;
+    int i, owner;
+    char *p;
+
+    for (;;) {
+	pthread_barrier_wait(&speed->start);
+	if (speed->quit)
+	    return NULL;
+	trace = speed->trace;
+	r->ops = 0;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (i = 0;  i < trace->num_ops;  i++) {
+	    op = &trace->ops[i];
+	    owner = op->index % num_threads;
+	    if (replay_mode == REPLAY_XFREE && op->type == FREE)
+		owner = (owner + 1) % num_threads;
+	    if (replay_mode != REPLAY_COPIES && owner != r->tid)
+		continue;
+
+	    if (replay_mode == REPLAY_XFREE)
+		while (__atomic_load_n(&speed->done[op->index], __ATOMIC_ACQUIRE)
+		       != speed->seq[i])
+		    sched_yield();
+
+	    switch (op->type) {
+
+	    case ALLOC: /* mm_malloc */
+		if (op->align)
+		    p = speed->libc ? aligned_alloc(op->align, op->size) :
+			mm_memalign(op->align, op->size);
+		else
+		    p = speed->libc ? malloc(op->size) : mm_malloc(op->size);
+		if (p == NULL)
+		    app_error("malloc error in replay_thread");
+		r->blocks[op->index] = p;
+		break;
+
+	    case REALLOC: /* mm_realloc */
+		p = r->blocks[op->index];
+		p = speed->libc ? realloc(p, op->size) : mm_realloc(p, op->size);
+		if (p == NULL)
+		    app_error("realloc error in replay_thread");
+		r->blocks[op->index] = p;
+		break;
+
+	    case FREE: /* mm_free */
+		if (speed->libc)
+		    free(r->blocks[op->index]);
+		else if (sized)
+		    mm_free_sized(r->blocks[op->index], op->size);
+		else
+		    mm_free(r->blocks[op->index]);
+		break;
+
+	    default:
+		app_error("Nonexistent request type in replay_thread");
+	    }
+
+	    if (replay_mode == REPLAY_XFREE)
+		__atomic_store_n(&speed->done[op->index], speed->seq[i] + 1,
+				 __ATOMIC_RELEASE);
+	    r->ops++;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	r->secs = (end.tv_sec - start.tv_sec) + 1E-9 * (end.tv_nsec - start.tv_nsec);
+	pthread_barrier_wait(&speed->end);
+    }
+}
+
+/*
+ * replay_latency - Record the per-thread latencies of the last run of a
+ *    concurrent replay; in copies mode every thread ran the whole trace
+ */
+static void replay_latency(speed_t *speed, stats_t *stats)
+{
+    int i;
+    double lat;
+
+    stats->lat_min = DBL_MAX;
+    stats->lat_avg = 0;
+    stats->lat_max = 0;
+    for (i = 0; i < num_threads; i++) {
+	replay_t *r = &speed->threads[i];
+	lat = r->ops ? 1E9 * r->secs / r->ops : 0;
+	stats->lat_min = (lat < stats->lat_min) ? lat : stats->lat_min;
+	stats->lat_max = (lat > stats->lat_max) ? lat : stats->lat_max;
+	stats->lat_avg += lat / num_threads;
+    }
+    if (replay_mode == REPLAY_COPIES)
+	stats->ops *= num_threads;
+}
+
+/*
+ * profile_percentiles - Record the call counts and percentiles of the
+ *    mm package's histograms, which cover its last timed run (every run
+ *    starts with mm_init). A percentile is the lower bound of the bucket
+ *    it falls into, within 25% of the true value.
+ */
+static void profile_percentiles(stats_t *stats)
+{
+    static mm_profile_t prof;
+    unsigned long total, sum;
+    int ev, b, j;
+
+    mm_get_profile(&prof);
+    for (ev = 0; ev < MM_PROF_EVENTS; ev++) {
+	total = 0;
+	for (b = 0; b < MM_PROF_BUCKETS; b++)
+	    total += prof.count[ev][b];
+	stats->prof_count[ev] = total;
+	sum = 0;
+	b = -1;
+	for (j = 0; j < NUM_PCTS; j++) {
+	    while (b < MM_PROF_BUCKETS - 1 && sum < pcts[j] / 100 * total)
+		sum += prof.count[ev][++b];
+	    stats->prof[ev][j] = (b < 0) ? 0 : MM_PROF_LOW(b);
+	}
+    }
 }
 
 /*
@@ -765,19 +2312,33 @@ static void eval_mm_speed(void *ptr)
 static int eval_libc_valid(trace_t *trace, int tracenum)
 {
     int i;
-    char *p;
+    char *p, *newp;
 
     for (i = 0;  i < trace->num_ops;  i++) {
         switch (trace->ops[i].type) {
 
         case ALLOC: /* malloc */
-	    if ((p = malloc(trace->ops[i].size)) == NULL) {
+	    if (trace->ops[i].align)
+		p = aligned_alloc(trace->ops[i].align, trace->ops[i].size);
+	    else
+		p = malloc(trace->ops[i].size);
+	    if (p == NULL) {
 		malloc_error(tracenum, i, "libc malloc failed");
 		unix_error("System message");
 	    }
 	    trace->blocks[trace->ops[i].index] = p;
 	    break;
 
+        case REALLOC: /* realloc */
+	    newp = realloc(trace->blocks[trace->ops[i].index],
+			   trace->ops[i].size);
+	    if (newp == NULL) {
+		malloc_error(tracenum, i, "libc realloc failed");
+		unix_error("System message");
+	    }
+	    trace->blocks[trace->ops[i].index] = newp;
+	    break;
+
         case FREE: /* free */
 	    free(trace->blocks[trace->ops[i].index]);
 	    break;
@@ -798,8 +2359,9 @@ static int eval_libc_valid(trace_t *trace, int tracenum)
 static void eval_libc_speed(void *ptr)
 {
     int i;
-    int index, size;
-    char *p, *block;
+    int index;
+    size_t size;
+    char *p, *block, *oldp, *newp;
     trace_t *trace = ((speed_t *)ptr)->trace;
 
     for (i = 0;  i < trace->num_ops;  i++) {
@@ -807,11 +2369,24 @@ static void eval_libc_speed(void *ptr)
         case ALLOC: /* malloc */
 	    index = trace->ops[i].index;
 	    size = trace->ops[i].size;
-	    if ((p = malloc(size)) == NULL)
+	    if (trace->ops[i].align)
+		p = aligned_alloc(trace->ops[i].align, size);
+	    else
+		p = malloc(size);
+	    if (p == NULL)
 		unix_error("malloc failed in eval_libc_speed");
 	    trace->blocks[index] = p;
 	    break;
 
+        case REALLOC: /* realloc */
+	    index = trace->ops[i].index;
+	    size = trace->ops[i].size;
+	    oldp = trace->blocks[index];
+	    if ((newp = realloc(oldp, size)) == NULL)
+		unix_error("realloc failed in eval_libc_speed");
+	    trace->blocks[index] = newp;
+	    break;
+
         case FREE: /* free */
 	    index = trace->ops[i].index;
 	    block = trace->blocks[index];
@@ -883,6 +2458,193 @@ static void printresults(int n, stats_t *stats)
 
 }
 
+/*
+ * printtiming - print how the time of each trace was measured: the
+ *     number of timed samples and runs of the trace per sample, the
+ *     fastest and the median run, and the 95% confidence interval of the
+ *     mean run (microseconds)
+ */
+static void printtiming(int n, stats_t *stats)
+{
+    int i;
+    fsecs_stats_t *t;
+
+    printf("\n%5s%8s%6s%10s%10s%10s%8s\n",
+	   "trace", "samples", "runs", "min", "median", "mean", "+-95%");
+    for (i=0; i < n; i++) {
+	if (!stats[i].valid)
+	    continue;
+	t = &stats[i].timing;
+	printf("%2d%11d%6d%10.1f%10.1f%10.1f%7.1f%%\n",
+	       i,
+	       t->runs,
+	       t->reps,
+	       1E6 * t->min,
+	       1E6 * t->median,
+	       1E6 * t->mean,
+	       100.0 * t->ci95 / t->mean);
+    }
+}
+
+/*
+ * printstalls - after a streaming replay (-S), print for each trace how
+ *     long the timed replay waited for the trace reader, which is not
+ *     counted in its secs
+ */
+static void printstalls(int n, stats_t *stats)
+{
+    int i;
+
+    printf("\n%5s%10s%10s\n", "trace", "secs", "stalled");
+    for (i=0; i < n; i++) {
+	if (!stats[i].valid)
+	    continue;
+	printf("%2d%13.6f%10.6f\n", i, stats[i].secs, stats[i].stall);
+    }
+}
+
+/*
+ * printreallocs - for the traces that contain realloc requests, print
+ *     how many of them were resized in place (same block address)
+ */
+static void printreallocs(int n, stats_t *stats)
+{
+    int i;
+    int header = 0;
+
+    for (i=0; i < n; i++) {
+	if (!stats[i].valid || stats[i].reallocs == 0)
+	    continue;
+	if (!header) {
+	    printf("\n%5s%10s%10s%8s\n",
+		   "trace", "reallocs", "in-place", "rate");
+	    header = 1;
+	}
+	printf("%2d%13d%10d%7.0f%%\n",
+	       i,
+	       stats[i].reallocs,
+	       stats[i].inplace,
+	       100.0 * stats[i].inplace / stats[i].reallocs);
+    }
+}
+
+/*
+ * printthreads - after a concurrent replay (-T), print the per-thread
+ *     latency (nanoseconds per request) of the slowest, average and
+ *     fastest thread for each trace
+ */
+static void printthreads(int n, stats_t *stats)
+{
+    int i;
+    static char *modes[] = {"split", "copies", "xfree"};
+
+    if (num_threads == 0)
+	return;
+
+    printf("\n%d threads (%s), ns per request and thread:\n",
+	   num_threads, modes[replay_mode]);
+    printf("%5s%9s%9s%9s\n", "trace", "min", "avg", "max");
+    for (i=0; i < n; i++) {
+	if (!stats[i].valid)
+	    continue;
+	printf("%2d%12.1f%9.1f%9.1f\n",
+	       i,
+	       stats[i].lat_min,
+	       stats[i].lat_avg,
+	       stats[i].lat_max);
+    }
+}
+
+/*
+ * printpolicies - after -P all, compare the placement policies by
+ *     average utilization and throughput over the valid traces
+ */
+static void printpolicies(int n, stats_t **stats)
+{
+    int i, p, valid;
+    double secs, ops, util;
+
+    printf("\n%-8s%6s%8s\n", "policy", "util", "Kops");
+    for (p = 0; p < NUM_POLICIES; p++) {
+	secs = ops = util = 0;
+	valid = 0;
+	for (i=0; i < n; i++) {
+	    if (!stats[p][i].valid)
+		continue;
+	    secs += stats[p][i].secs;
+	    ops += stats[p][i].ops;
+	    util += stats[p][i].util;
+	    valid++;
+	}
+	if (valid == 0 || secs == 0)
+	    printf("%-8s%6s%8s\n", policy_names[p], "-", "-");
+	else
+	    printf("%-8s%5.0f%%%8.0f\n",
+		   policy_names[p],
+		   (util/valid)*100.0,
+		   (ops/1e3)/secs);
+    }
+    printf("\n");
+}
+
+/*
+ * printheap - print the peak heap size of each trace and, after each
+ *     quarter of its requests, the heap size and (in parentheses) how
+ *     much of it was resident, all in KB
+ */
+static void printheap(int n, stats_t *stats)
+{
+    int i, j;
+
+    printf("\n%5s%8s", "trace", "peak");
+    for (j = 0; j < HEAP_SAMPLES; j++)
+	printf("%15d%%", 100 * (j + 1) / HEAP_SAMPLES);
+    printf("\n");
+    for (i=0; i < n; i++) {
+	if (!stats[i].valid)
+	    continue;
+	printf("%2d%11zu", i, stats[i].heap_peak / 1024);
+	for (j = 0; j < HEAP_SAMPLES; j++)
+	    printf("%8zu (%5zu)", stats[i].heap[j] / 1024,
+		   stats[i].resident[j] / 1024);
+	printf("\n");
+    }
+}
+
+/*
+ * printprofile - with -p, print for every profiled event of mm malloc
+ *     and every trace the number of calls and the percentiles of their
+ *     ticks (free blocks looked at for the fit searches)
+ */
+static void printprofile(int n, stats_t *stats)
+{
+    int i, ev, j;
+    char name[16];
+
+    for (ev = 0; ev < MM_PROF_EVENTS; ev++) {
+	printf("\n%s, %s per call:\n", prof_names[ev],
+	       (ev == MM_PROF_SEARCH) ? "free blocks" : "ticks");
+	printf("%5s%10s", "trace", "calls");
+	for (j = 0; j < NUM_PCTS; j++) {
+	    if (pcts[j] == 100)
+		strcpy(name, "max");
+	    else
+		sprintf(name, "p%g", pcts[j]);
+	    printf("%9s", name);
+	}
+	printf("\n");
+	for (i = 0; i < n; i++) {
+	    if (!stats[i].valid)
+		continue;
+	    printf("%2d%13lu", i, stats[i].prof_count[ev]);
+	    for (j = 0; j < NUM_PCTS; j++)
+		printf("%9lu", stats[i].prof[ev][j]);
+	    printf("\n");
+	}
+    }
+    printf("\n");
+}
+
 /*
  * app_error - Report an arbitrary application error
  */
@@ -915,14 +2677,41 @@ void malloc_error(int tracenum, int opnum, char *msg)
  */
 static void usage(void)
 {
-    fprintf(stderr, "Usage: mdriver [-hvVal] [-f <file>] [-t <dir>]\n");
+    fprintf(stderr, "Usage: mdriver [-hvValbesSp] [-f <file>] [-t <dir>] [-T <n> [-R <mode>]] [-P <policy>]\n");
+    fprintf(stderr, "               [-m <trim>[:<release>]] [-d <pct>] [-r <pct>] [-M <sel>]\n");
+    fprintf(stderr, "       mdriver -f <file> -c <binfile>\n");
     fprintf(stderr, "Options\n");
     fprintf(stderr, "\t-a         Don't check the group structure.\n");
-    fprintf(stderr, "\t-f <file>  Use <file> as the trace file.\n");
+    fprintf(stderr, "\t-b         Replay runs of same-size allocations and of frees\n");
+    fprintf(stderr, "\t           with mm_malloc_batch and mm_free_batch (not with -T).\n");
+    fprintf(stderr, "\t-c <file>  Write the trace of -f to <file> in the binary format\n");
+    fprintf(stderr, "\t           (see trace.h), and exit.\n");
+    fprintf(stderr, "\t-d <pct>   Let mm malloc defer coalescing small blocks until\n");
+    fprintf(stderr, "\t           they hold pct percent of the heap.\n");
+    fprintf(stderr, "\t-e         Run the realloc traces after the default ones.\n");
+    fprintf(stderr, "\t-f <file>  Use <file> as the trace file, text or binary.\n");
     fprintf(stderr, "\t-g         Generate summary info for autograder.\n");
     fprintf(stderr, "\t-h         Print this message.\n");
     fprintf(stderr, "\t-l         Run libc malloc as well.\n");
     fprintf(stderr, "\t-t <dir>   Directory to find default traces.\n");
+    fprintf(stderr, "\t-T <n>     Time the traces with n concurrent threads.\n");
+    fprintf(stderr, "\t-R <mode>  How -T shares a trace: split (ids over threads),\n");
+    fprintf(stderr, "\t           copies (a copy per thread), xfree (split, but\n");
+    fprintf(stderr, "\t           blocks are freed by another thread).\n");
+    fprintf(stderr, "\t-p         Print percentiles of the mm malloc profile (mm.c\n");
+    fprintf(stderr, "\t           compiled with MM_PROFILE).\n");
+    fprintf(stderr, "\t-P <pol>   Placement policy of mm malloc: first, best[:K],\n");
+    fprintf(stderr, "\t           addr, or all to compare them.\n");
+    fprintf(stderr, "\t-M <sel>   Time of a trace: kbest (fastest run, once the\n");
+    fprintf(stderr, "\t           K fastest agree; default) or median.\n");
+    fprintf(stderr, "\t-m <t>[:r] Let mm malloc keep t free bytes at the top of\n");
+    fprintf(stderr, "\t           the heap and release free blocks of r bytes.\n");
+    fprintf(stderr, "\t-r <pct>   Let mm malloc round requests up to frequent sizes\n");
+    fprintf(stderr, "\t           at most pct percent larger, 0 = never (default 15).\n");
+    fprintf(stderr, "\t-S         Stream each trace from its file while it is replayed,\n");
+    fprintf(stderr, "\t           for traces too large for memory (not with -T, -b, -l).\n");
+    fprintf(stderr, "\t-s         Free with mm_free_sized, the sizes are checked\n");
+    fprintf(stderr, "\t           while the traces are checked for correctness.\n");
     fprintf(stderr, "\t-v         Print per-trace performance breakdowns.\n");
     fprintf(stderr, "\t-V         Print additional debug info.\n");
 }
@@ -2,7 +2,16 @@
  * memlib.c - a module that simulates the memory system.  Needed because it
  *            allows us to interleave calls from the student's malloc package
  *            with the system's malloc package in libc.
+ *
+ *            The modeled memory consists of MAX_ARENAS independent arenas,
+ *            each a contiguous region of up to MAX_HEAP bytes with its own
+ *            brk pointer. Arena 0 is "the heap" of the classic interface
+ *            (mem_sbrk, mem_heap_lo, mem_heap_hi). An arena can shrink
+ *            again; the pages it gives up are returned to the system.
+ *            Large blocks can live in mappings of their own outside the
+ *            arenas (mem_map); they count towards the heap size.
  */
+#define _GNU_SOURCE /* mremap */
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
@@ -10,28 +19,63 @@
 #include <sys/mman.h>
 #include <string.h>
 #include <errno.h>
+#include <pthread.h>
 
 #include "memlib.h"
 #include "config.h"
 
+/* One independently growing region */
+typedef struct {
+    char *start_brk;  /* points to first byte of the arena */
+    char *brk;        /* points to last byte of the arena */
+    char *max_addr;   /* largest legal arena address */
+    char *peak_brk;   /* highest brk since the last mem_reset_brk */
+    char *clean;      /* never written above here: not yet handed out, or given back */
+} mem_arena_t;
+
+/* One region obtained with mem_map */
+typedef struct mem_mapping {
+    char *start;                /* first byte of the mapping */
+    size_t len;                 /* its length, a multiple of the page size */
+    struct mem_mapping *next;
+} mem_mapping_t;
+
 /* private variables */
-static char *mem_start_brk;  /* points to first byte of heap */
-static char *mem_brk;        /* points to last byte of heap */
-static char *mem_max_addr;   /* largest legal heap address */
+static char *mem_start_brk;  /* points to first byte of the first arena */
+static char *mem_max_addr;   /* largest legal address of the last arena */
+static mem_arena_t mem_arenas[MAX_ARENAS];
+static mem_mapping_t *mem_mappings;  /* live mappings */
+static size_t mem_mapped;            /* bytes in them ... */
+static size_t mem_peak_mapped;       /* ... and the most since the last mem_reset_brk */
+static pthread_mutex_t mem_map_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static size_t resident(char *start, size_t len);
 
 /*
  * mem_init - initialize the memory system model
  */
 void mem_init(void)
 {
-    /* allocate the storage we will use to model the available VM */
-    if ((mem_start_brk = (char *)malloc(MAX_HEAP)) == NULL) {
-	fprintf(stderr, "mem_init_vm: malloc error\n");
+    int i;
+
+    /* reserve the storage we will use to model the available VM; pages
+       are only backed once an arena's brk moves over them */
+    mem_start_brk = mmap(NULL, (size_t)MAX_ARENAS * MAX_HEAP,
+			 PROT_READ | PROT_WRITE,
+			 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (mem_start_brk == MAP_FAILED) {
+	fprintf(stderr, "mem_init_vm: mmap error\n");
 	exit(1);
     }
+    mem_max_addr = mem_start_brk + (size_t)MAX_ARENAS * MAX_HEAP;
 
-    mem_max_addr = mem_start_brk + MAX_HEAP;  /* max legal heap address */
-    mem_brk = mem_start_brk;                  /* heap is empty initially */
+    for (i = 0; i < MAX_ARENAS; i++) {
+	mem_arenas[i].start_brk = mem_start_brk + (size_t)i * MAX_HEAP;
+	mem_arenas[i].max_addr = mem_arenas[i].start_brk + MAX_HEAP;
+	mem_arenas[i].brk = mem_arenas[i].start_brk; /* arenas are empty initially */
+	mem_arenas[i].peak_brk = mem_arenas[i].start_brk;
+	mem_arenas[i].clean = mem_arenas[i].start_brk;
+    }
 }
 
 /*
@@ -39,41 +83,217 @@ void mem_init(void)
  */
 void mem_deinit(void)
 {
-    free(mem_start_brk);
+    munmap(mem_start_brk, (size_t)MAX_ARENAS * MAX_HEAP);
 }
 
 /*
- * mem_reset_brk - reset the simulated brk pointer to make an empty heap
+ * mem_reset_brk - reset the simulated brk pointers to make empty arenas,
+ *    and unmap the mappings that are still there
  */
 void mem_reset_brk()
 {
-    mem_brk = mem_start_brk;
+    mem_mapping_t *m;
+    int i;
+
+    for (i = 0; i < MAX_ARENAS; i++)
+	mem_arenas[i].brk = mem_arenas[i].peak_brk = mem_arenas[i].start_brk;
+
+    while ((m = mem_mappings) != NULL) {
+	mem_mappings = m->next;
+	munmap(m->start, m->len);
+	free(m);
+    }
+    mem_mapped = mem_peak_mapped = 0;
 }
 
 /*
  * mem_sbrk - simple model of the sbrk function. Extends the heap
- *    by incr bytes and returns the start address of the new area. In
- *    this model, the heap cannot be shrunk.
+ *    by incr bytes and returns the start address of the new area
+ *    (the old brk). A negative incr shrinks the heap.
  */
-void *mem_sbrk(int incr)
+void *mem_sbrk(intptr_t incr)
 {
-    char *old_brk = mem_brk;
+    return mem_arena_sbrk(0, incr);
+}
 
-    if ( (incr < 0) || ((mem_brk + incr) > mem_max_addr)) {
+/*
+ * mem_arena_sbrk - mem_sbrk for one arena. Arenas are independent, so
+ *    different arenas may be extended concurrently; calls for the same
+ *    arena must be serialized by the caller. Whole pages above the new
+ *    brk of a shrinking arena are given back to the system, which makes
+ *    them clean again if nothing above them was ever written.
+ */
+void *mem_arena_sbrk(int arena, intptr_t incr)
+{
+    mem_arena_t *a = &mem_arenas[arena];
+    char *old_brk = a->brk;
+
+    if (incr > a->max_addr - a->brk) {
 	errno = ENOMEM;
 	fprintf(stderr, "ERROR: mem_sbrk failed. Ran out of memory...\n");
 	return (void *)-1;
     }
-    mem_brk += incr;
+    if (incr < a->start_brk - a->brk) {
+	errno = EINVAL;
+	fprintf(stderr, "ERROR: mem_sbrk failed. Shrinking below the start of the heap...\n");
+	return (void *)-1;
+    }
+    a->brk += incr;
+    if (a->brk > a->peak_brk)
+	a->peak_brk = a->brk;
+    if (a->brk > a->clean)
+	a->clean = a->brk;
+    if (incr < 0 && mem_release(a->brk, old_brk - a->brk) > 0 &&
+	a->clean <= (char *)((size_t)old_brk & ~(mem_pagesize() - 1)))
+	a->clean = (char *)(((size_t)a->brk + mem_pagesize() - 1) & ~(mem_pagesize() - 1));
     return (void *)old_brk;
 }
 
+/*
+ * mem_arena_clean - the lowest address of an arena above which its
+ *    memory still reads as zeros: it was never handed out by
+ *    mem_arena_sbrk, or was given back since. Always at or above the brk;
+ *    mem_reset_brk leaves it where it is, the old contents are still there.
+ */
+void *mem_arena_clean(int arena)
+{
+    return (void *)mem_arenas[arena].clean;
+}
+
+/*
+ * mem_release - tell the system that the contents of [start, start+len)
+ *    are no longer needed (madvise MADV_DONTNEED). Only the whole pages
+ *    within the range are released; they read as zeros when touched
+ *    again. Returns the number of bytes released.
+ */
+size_t mem_release(void *start, size_t len)
+{
+    size_t pagesize = mem_pagesize();
+    char *lo = (char *)(((size_t)start + pagesize - 1) & ~(pagesize - 1));
+    char *hi = (char *)(((size_t)start + len) & ~(pagesize - 1));
+
+    if (hi <= lo)
+	return 0;
+    if (madvise(lo, hi - lo, MADV_DONTNEED) < 0) {
+	fprintf(stderr, "ERROR: mem_release failed: %s\n", strerror(errno));
+	return 0;
+    }
+    return (size_t)(hi - lo);
+}
+
+/*
+ * mem_map - map a region of len bytes (rounded up to whole pages) outside
+ *    the arenas and return its page aligned start address, or (void *)-1
+ */
+void *mem_map(size_t len)
+{
+    mem_mapping_t *m;
+
+    len = (len + mem_pagesize() - 1) & ~(mem_pagesize() - 1);
+    if ((m = malloc(sizeof(mem_mapping_t))) == NULL)
+	return (void *)-1;
+    m->start = mmap(NULL, len, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (m->start == MAP_FAILED) {
+	fprintf(stderr, "ERROR: mem_map failed: %s\n", strerror(errno));
+	free(m);
+	return (void *)-1;
+    }
+    m->len = len;
+
+    pthread_mutex_lock(&mem_map_lock);
+    m->next = mem_mappings;
+    mem_mappings = m;
+    mem_mapped += len;
+    if (mem_mapped > mem_peak_mapped)
+	mem_peak_mapped = mem_mapped;
+    pthread_mutex_unlock(&mem_map_lock);
+    return m->start;
+}
+
+/*
+ * mem_remap - resize the mapping that starts at start to len bytes
+ *    (rounded up to whole pages), moving it if need be. Returns the
+ *    new start address, or (void *)-1 and leaves the mapping alone.
+ */
+void *mem_remap(void *start, size_t len)
+{
+    mem_mapping_t *m;
+    char *p;
+
+    len = (len + mem_pagesize() - 1) & ~(mem_pagesize() - 1);
+    pthread_mutex_lock(&mem_map_lock);
+    for (m = mem_mappings; m != NULL && m->start != start; m = m->next)
+	;
+    if (m == NULL) {
+	pthread_mutex_unlock(&mem_map_lock);
+	fprintf(stderr, "ERROR: mem_remap: %p is not a mapping\n", start);
+	return (void *)-1;
+    }
+    if ((p = mremap(m->start, m->len, len, MREMAP_MAYMOVE)) == MAP_FAILED) {
+	pthread_mutex_unlock(&mem_map_lock);
+	fprintf(stderr, "ERROR: mem_remap failed: %s\n", strerror(errno));
+	return (void *)-1;
+    }
+    mem_mapped += len - m->len;
+    if (mem_mapped > mem_peak_mapped)
+	mem_peak_mapped = mem_mapped;
+    m->start = p;
+    m->len = len;
+    pthread_mutex_unlock(&mem_map_lock);
+    return p;
+}
+
+/*
+ * mem_unmap - give the mapping that starts at start back to the system;
+ *    returns 0, or -1 if there is no such mapping
+ */
+int mem_unmap(void *start)
+{
+    mem_mapping_t **mp, *m;
+
+    pthread_mutex_lock(&mem_map_lock);
+    for (mp = &mem_mappings; *mp != NULL && (*mp)->start != start; mp = &(*mp)->next)
+	;
+    if ((m = *mp) == NULL) {
+	pthread_mutex_unlock(&mem_map_lock);
+	fprintf(stderr, "ERROR: mem_unmap: %p is not a mapping\n", start);
+	return -1;
+    }
+    *mp = m->next;
+    mem_mapped -= m->len;
+    pthread_mutex_unlock(&mem_map_lock);
+
+    munmap(m->start, m->len);
+    free(m);
+    return 0;
+}
+
+/*
+ * mem_mapping_of - if p lies in a mapping, store the addresses of its
+ *    first and last byte in *lo and *hi and return 1, else return 0
+ */
+int mem_mapping_of(const void *p, void **lo, void **hi)
+{
+    mem_mapping_t *m;
+
+    pthread_mutex_lock(&mem_map_lock);
+    for (m = mem_mappings; m != NULL; m = m->next)
+	if ((char *)p >= m->start && (char *)p < m->start + m->len) {
+	    *lo = m->start;
+	    *hi = m->start + m->len - 1;
+	    break;
+	}
+    pthread_mutex_unlock(&mem_map_lock);
+    return m != NULL;
+}
+
 /*
  * mem_heap_lo - return address of the first heap byte
  */
 void *mem_heap_lo()
 {
-    return (void *)mem_start_brk;
+    return mem_arena_lo(0);
 }
 
 /*
@@ -81,15 +301,124 @@ void *mem_heap_lo()
  */
 void *mem_heap_hi()
 {
-    return (void *)(mem_brk - 1);
+    return mem_arena_hi(0);
 }
 
 /*
- * mem_heapsize() - returns the heap size in bytes
+ * mem_arena_lo - return address of the first byte of an arena
+ */
+void *mem_arena_lo(int arena)
+{
+    return (void *)mem_arenas[arena].start_brk;
+}
+
+/*
+ * mem_arena_hi - return address of the last byte of an arena
+ */
+void *mem_arena_hi(int arena)
+{
+    return (void *)(mem_arenas[arena].brk - 1);
+}
+
+/*
+ * mem_arena_of - return the arena whose reserved region contains p,
+ *    or -1 if p lies outside the modeled memory
+ */
+int mem_arena_of(const void *p)
+{
+    if ((char *)p < mem_start_brk || (char *)p >= mem_max_addr)
+	return -1;
+    return (int)(((char *)p - mem_start_brk) / MAX_HEAP);
+}
+
+/*
+ * mem_mapsize() - returns the bytes in live mappings
+ */
+size_t mem_mapsize()
+{
+    size_t size;
+
+    pthread_mutex_lock(&mem_map_lock);
+    size = mem_mapped;
+    pthread_mutex_unlock(&mem_map_lock);
+    return size;
+}
+
+/*
+ * mem_heapsize() - returns the heap size in bytes, summed over all arenas
+ *    and mappings
  */
 size_t mem_heapsize()
 {
-    return (size_t)(mem_brk - mem_start_brk);
+    size_t size = mem_mapped;
+    int i;
+
+    for (i = 0; i < MAX_ARENAS; i++)
+	size += mem_arena_heapsize(i);
+    return size;
+}
+
+/*
+ * mem_peak_heapsize() - returns the highest size in bytes each arena had
+ *    since the last mem_reset_brk, summed over all arenas, plus the most
+ *    bytes that were mapped at a time
+ */
+size_t mem_peak_heapsize()
+{
+    size_t size = mem_peak_mapped;
+    int i;
+
+    for (i = 0; i < MAX_ARENAS; i++)
+	size += (size_t)(mem_arenas[i].peak_brk - mem_arenas[i].start_brk);
+    return size;
+}
+
+/*
+ * mem_resident() - returns how many bytes below the brk of all arenas and
+ *    in the mappings are resident in memory (mincore), i.e. not released
+ */
+size_t mem_resident()
+{
+    size_t size = 0;
+    mem_mapping_t *m;
+    int i;
+
+    for (i = 0; i < MAX_ARENAS; i++)
+	size += resident(mem_arenas[i].start_brk, mem_arena_heapsize(i));
+    pthread_mutex_lock(&mem_map_lock);
+    for (m = mem_mappings; m != NULL; m = m->next)
+	size += resident(m->start, m->len);
+    pthread_mutex_unlock(&mem_map_lock);
+    return size;
+}
+
+/*
+ * resident - how many bytes of the pages of [start, start+len) are
+ *    resident in memory; start is page aligned
+ */
+static size_t resident(char *start, size_t len)
+{
+    size_t pagesize = mem_pagesize();
+    size_t pages = (len + pagesize - 1) / pagesize;
+    size_t size = 0, j;
+    unsigned char *vec;
+
+    if (len == 0 || (vec = malloc(pages)) == NULL)
+	return 0;
+    if (mincore(start, len, vec) == 0)
+	for (j = 0; j < pages; j++)
+	    if (vec[j] & 1)
+		size += pagesize;
+    free(vec);
+    return size;
+}
+
+/*
+ * mem_arena_heapsize() - returns the size of one arena in bytes
+ */
+size_t mem_arena_heapsize(int arena)
+{
+    return (size_t)(mem_arenas[arena].brk - mem_arenas[arena].start_brk);
 }
 
 /*
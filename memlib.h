@@ -1,11 +1,29 @@
 #include <unistd.h>
+#include <stdint.h>
 
 void mem_init(void);
 void mem_deinit(void);
-void *mem_sbrk(int incr);
+void *mem_sbrk(intptr_t incr);
 void mem_reset_brk(void);
 void *mem_heap_lo(void);
 void *mem_heap_hi(void);
 size_t mem_heapsize(void);
 size_t mem_pagesize(void);
+size_t mem_peak_heapsize(void);
+size_t mem_resident(void);
+size_t mem_release(void *start, size_t len);
 
+/* Independent arenas; arena 0 is the heap used by the functions above */
+void *mem_arena_sbrk(int arena, intptr_t incr);
+void *mem_arena_lo(int arena);
+void *mem_arena_hi(int arena);
+size_t mem_arena_heapsize(int arena);
+void *mem_arena_clean(int arena);
+int mem_arena_of(const void *p);
+
+/* Regions mapped outside the arenas, for blocks too large for a heap */
+void *mem_map(size_t len);
+void *mem_remap(void *start, size_t len);
+int mem_unmap(void *start);
+int mem_mapping_of(const void *p, void **lo, void **hi);
+size_t mem_mapsize(void);
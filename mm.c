@@ -7,11 +7,23 @@
  * NOTE TO STUDENTS: Replace this header comment with your own header
  * comment that gives a high level description of your solution.
  */
+#define _GNU_SOURCE                                             // sched_getcpu
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#ifdef MM_PROFILE
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#endif
 #include "mm.h"
 #include "memlib.h"
+#include "config.h"
 
 /*********************************************************
  * NOTE TO STUDENTS: Before you do anything else, please
@@ -45,10 +57,76 @@ group_t group = {
 // move chonksize up to get faster: 1<<8 or 1<<9 yields optimal result on server, we chose 1<<9 because it works a bit faster
 #define CHONKSIZE             (1<<9)                            /* Extend heap by this amount (bytes) */
 #define POINTERSIZE           sizeof(void *)                    //size of one pointer
-#define MIN_SIZE              (DSIZE+2*POINTERSIZE)             // one DWORD for header/footer, one for 8byte next pointer, one for same size previous pointer
-#define SIZE_OF_SEG_STORAGE   (number_of_lists*POINTERSIZE)     //total number of bytes used to store our lists in beginning of heap
+#define MIN_SIZE              (DSIZE+2*POINTERSIZE)             // one DWORD for header/footer of a free block, one for 8byte next pointer, one for same size previous pointer
+#define SIZE_OF_SEG_STORAGE   (number_of_lists*POINTERSIZE)     //total number of bytes used to store our lists (in the arena)
+
+/* Two-level segregated fit (TLSF) index over the free lists: first level class fl by the most significant bit of the
+ * size, split into SL_COUNT second level classes by the next SL_LOG2 bits. Blocks below 1<<FL_SHIFT all go to fl 0,
+ * split linearly. Bitmaps of the non-empty classes find the first class holding a fit with count-trailing-zeros. */
+#define SL_LOG2               2
+#define SL_COUNT              (1 << SL_LOG2)
+#define FL_SHIFT              6
+#define FL_COUNT              20                                // fl 19: blocks of 1<<24 bytes and more, nothing larger fits into MAX_HEAP
+#define FIT_SCAN              8                                 // blocks looked at in a request's own class, those may be too small
+#define MSB(x)                (63 - __builtin_clzl(x))          //index of most significant bit, x > 0
+
+_Static_assert(FL_COUNT * SL_COUNT == MM_STATS_LISTS, "mm_stats_t counts the blocks of every free list");
+
+/* Slab layer: requests up to SLAB_MAX bytes are served from page-sized runs, each holding objects of one size class
+ * and no boundary tags. A run is an ordinary allocated block of RUN_SIZE bytes whose payload is aligned to RUN_SIZE
+ * (so runs next to each other tile the pages), and the run header is found by masking an object's address. A class
+ * only gets runs once RUN_SIZE bytes of blocks with boundary tags of its size are live, so a class with just a few
+ * objects does not cost a whole page. */
+#define RUN_SIZE              4096
+#define RUN_MAP_WORDS         (RUN_SIZE / DSIZE / 64)           // free bitmap words, enough for the smallest class
+#define SLAB_MAX              256                               // largest request served by the slab layer
+#define SLAB_CLASSES          16
+#define RUN_OF(bp)            ((run_t *)((unsigned long)(bp) & ~(unsigned long)(RUN_SIZE - 1)))
+#define SLAB_CLASS(size)      (slab_class_of[((size) + DSIZE - 1) / DSIZE])
+#define SLAB_KEY(asize)       SLAB_CLASS((asize) - DSIZE)       //class a block with boundary tags counts for, asize - DSIZE <= SLAB_MAX
+
+/* Per-thread cache (thread-safe mode only): one bin per slab class */
+#define TCACHE_BINS           SLAB_CLASSES
+#define TCACHE_COUNT          16                                // blocks a bin may hold before it is flushed
+#define TCACHE_BATCH          8                                 // blocks moved per refill / flush of a bin
+
+/* Deferred coalescing (MM_OPT_DEFER): freed blocks up to QUICK_MAX bytes wait in exact-size quick bins */
+#define QUICK_MAX             1024
+#define QUICK_BINS            (QUICK_MAX / DSIZE + 1)
+#define QUICK_COUNT           64                                // blocks a bin may hold before the arena coalesces
+
+/* Learned rounding (MM_OPT_ROUND): requests above SLAB_MAX (the slab classes round smaller ones) and up to
+ * ROUND_MAX bytes are counted per DSIZE granule. Every ROUND_PERIOD counted requests the rounding table is rebuilt
+ * from the counts, which are halved then, so old phases fade. Thread-safe mode counts one request in ROUND_SAMPLE
+ * per thread */
+#define ROUND_MAX             4096                              // largest request that is counted and rounded
+#define ROUND_SLOTS           (ROUND_MAX / DSIZE + 1)
+#define ROUND_PERIOD          1024
+#define ROUND_SAMPLE          16                                // a power of two
+#define ROUND_SHARE           16                                // a size is a target with 1/ROUND_SHARE of the counts
+
+/* mm_malloc_batch carves its blocks from free regions of at most BATCH_BYTES */
+#define BATCH_BYTES           (64 * 1024)
+
+/* Profiling (compile with -DMM_PROFILE): PROF_MARK keeps a value to measure from, PROF_ADD counts a value in the
+ * histogram of an event. Without MM_PROFILE they are no code at all, their arguments are never evaluated */
+#ifdef MM_PROFILE
+#if defined(__x86_64__) || defined(__i386__)
+#define PROF_NOW()            __rdtsc()
+#else
+#define PROF_NOW()            prof_ns()
+#endif
+#define PROF_MARK(v, x)       unsigned long v = (x)
+#define PROF_ADD(ev, x)       prof_add(ev, x)
+#else
+#define PROF_MARK(v, x)
+#define PROF_ADD(ev, x)
+#endif
+#define PROF_BEGIN(t)         PROF_MARK(t, PROF_NOW())
+#define PROF_END(ev, t)       PROF_ADD(ev, PROF_NOW() - (t))
 
 #define MAX(x, y) ((x) > (y)? (x) : (y))                        //Group 79: If x > y THEN x, IF NOT, then y.
+#define MIN(x, y) ((x) < (y)? (x) : (y))
 
 /* Pack a size and allocated bit into a word */
 #define PACK(size, alloc)  ((size) | (alloc))                   //Group 79: | is the bitwise OR
@@ -66,9 +144,9 @@ group_t group = {
 #define GET_NEXT(bp)     *GO_NEXT(bp)                           //move to the stored address
 #define GET_PREVIOUS(bp) *GO_PREVIOUS(bp)
 
-//for segregated lists: uses the head of the segregated list to move to the memory location/address of a specific list
-#define GO_LIST(offset) (((unsigned long **)(((char *)seg_list_head)+(POINTERSIZE*(offset)))))
-#define GET_LIST(offset) *(GO_LIST(offset))
+//for segregated lists: uses the head of arena a's segregated lists to move to the memory location/address of a specific list
+#define GO_LIST(a, offset) (((unsigned long **)(((char *)(a)->seg_list_head)+(POINTERSIZE*(offset)))))
+#define GET_LIST(a, offset) *(GO_LIST(a, offset))
 
 // read eight bit at ptr and store the in loc
 #define PUT_POINTER(loc, ptr) (*(unsigned long *)(loc) =((void *)(ptr)))
@@ -91,199 +169,1751 @@ group_t group = {
  */
 #define GET_ALLOC(p) (GET(p) & 0x1)
 
+/* Only free blocks have a footer: bit 1 of a header tells whether the previous block is allocated, so coalesce
+ * reads the previous block's footer only if there is one. The bit has to be kept up to date whenever a block
+ * changes between allocated and free. */
+#define PREV_ALLOC          0x2
+#define GET_PREV_ALLOC(p)   (GET(p) & PREV_ALLOC)
+#define SET_PREV_ALLOC(p)   PUT(p, GET(p) | PREV_ALLOC)
+#define CLEAR_PREV_ALLOC(p) PUT(p, GET(p) & ~PREV_ALLOC)
+
+/* Learned rounding: bit 2 of an allocated block's header tells that its last payload word (past the request) holds
+ * the size requested, in the low 16 bits, and the bytes rounding added to the block, in the high 16 bits */
+#define REQ_TAG             0x4
+#define REQ_WORD(bp)        ((char *)(bp) + GET_SIZE(HDRP(bp)) - DSIZE)
+
 /* Given block ptr bp, compute address of its header and footer */
 /* Group 79: char pointer used because a char size is one byte, so adding one to the pointer moves it to next byte in memory,
  * whereas adding one to an int pointer would move it 4 bytes on since an int's size is 4 bytes */
 #define HDRP(bp)       ((char *)(bp) - WSIZE)
 #define FTRP(bp)       ((char *)(bp) + GET_SIZE(HDRP(bp)) - DSIZE)
 
-/* Given block ptr bp, compute address of next and previous blocks */
-#define NEXT_BLKP(bp)  ((char *)(bp) + GET_SIZE(((char *)(bp) - WSIZE)))
-#define PREV_BLKP(bp)  ((char *)(bp) - GET_SIZE(((char *)(bp) - DSIZE)))
+/* Given block ptr bp, compute address of next and previous blocks (the previous one only if it is free) */
+#define NEXT_BLKP(bp)  ((char *)(bp) + GET_SIZE(((char *)(bp) - WSIZE)))
+#define PREV_BLKP(bp)  ((char *)(bp) - GET_SIZE(((char *)(bp) - DSIZE)))
+
+/* Blocks of at least opt_mmap_threshold bytes get a memlib mapping of their own, outside every arena. The MAP_HDR
+ * bytes before the payload hold the length of the mapping as a full size_t and the distance from its start to the
+ * payload (MAP_HDR, more for aligned blocks): headers of heap blocks are 32 bits, enough for any block of a MAX_HEAP
+ * arena, so requests too large for an arena are always mapped. */
+#define MAP_HDR                (2 * DSIZE)
+#define IS_MAPPED(bp)          (mem_arena_of(bp) < 0)
+#define MAP_LEN(bp)            (*(size_t *)((char *)(bp) - 2 * DSIZE))
+#define MAP_LEAD(bp)           (*(size_t *)((char *)(bp) - DSIZE))
+#define MAP_START(bp)          ((char *)(bp) - MAP_LEAD(bp))
+#define WANTS_MAPPING(size)    ((opt_mmap_threshold && (size) >= opt_mmap_threshold) || (size) > MAX_HEAP)
+
+_Static_assert(MAX_HEAP <= 0xFFFFFFF8UL, "block sizes of a heap must fit the 32-bit headers");
+
+/*
+ * Header at the start of a run. Bit i of map is set iff object i is free.
+ */
+typedef struct run {
+    struct run *next;                               // runs of the same class that have free objects
+    struct run *prev;
+    unsigned int size;                              // object size of the class
+    unsigned int cls;
+    unsigned int nobj;                              // objects in the run
+    unsigned int nfree;                             // ... and how many of them are free
+    unsigned long map[RUN_MAP_WORDS];
+} run_t;
+
+/*
+ * An arena is one independent heap in its own memlib arena, with its own segregated lists and lock.
+ * Without thread-safe mode only arena 0 is used and the lock is never taken.
+ */
+typedef struct {
+    char *heap_listp;                               /* Pointer to first block, 0 until the arena is initialized */
+    void **seg_list_head;                           // pointer to location in memory where the heads of the lists are stored, other lists stored directly below
+    void *seg_lists[FL_COUNT * SL_COUNT];           // ... which is here rather than at the start of the heap
+    unsigned int fl_bitmap;                         // bit fl set iff some list of first level class fl is non-empty
+    unsigned char sl_bitmap[FL_COUNT];              // bit sl set iff list (fl, sl) is non-empty
+    char *base;                                     // first byte of the memlib arena
+    run_t *runs[SLAB_CLASSES];                      // per slab class: runs with free objects
+    unsigned long run_map[MAX_HEAP / RUN_SIZE / 64];// bit set iff that page of the arena is a run
+    void *quick[QUICK_BINS];                        // per block size / DSIZE: freed blocks waiting to be coalesced
+    unsigned int quick_count[QUICK_BINS];
+    size_t quick_bytes;                             // ... and the bytes in all of them
+    size_t round_slack;                             // bytes learned rounding added to the live blocks
+    mm_stats_t stats;                               // free list counters and events, the rest is filled in by mm_get_stats
+    int id;                                         // memlib arena holding this heap
+    pthread_mutex_t lock;                           // protects the heap in thread-safe mode
+} arena_t;
+
+/* Global variables */
+static arena_t arenas[MAX_ARENAS];
+static int number_of_arenas = 1;                    // arenas in use since the last mm_init
+static unsigned int next_arena = 0;                 // round-robin counter for binding threads to arenas
+static int number_of_lists = FL_COUNT * SL_COUNT;  // total number of lists, their heads are in the arena
+
+/* Object sizes of the slab classes, and the class of every request size in DSIZE steps */
+static const unsigned int slab_size[SLAB_CLASSES] = {8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256};
+static const unsigned char slab_class_of[SLAB_MAX / DSIZE + 1] = {
+        0, 0, 1, 2, 3, 4, 5, 6, 7, 8, 8, 9, 9, 10, 10, 11, 11,
+        12, 12, 12, 12, 13, 13, 13, 13, 14, 14, 14, 14, 15, 15, 15, 15};
+static int slab_demand[SLAB_CLASSES];               // bytes in live blocks with boundary tags per class, until ...
+static unsigned char slab_on[SLAB_CLASSES];         // ... the class is switched to runs for good (until mm_init)
+
+/* Thread-safe mode: every arena is shared and protected by its lock, each thread keeps a cache of blocks in
+ * front of them. Cached blocks stay marked allocated in the heap, so nobody else touches them. */
+static int opt_threads = 0;                         // set with mm_setopt(MM_OPT_THREADS, 1) before mm_init
+static int opt_arenas = 0;                          // arenas to use in thread-safe mode, 0 = one per CPU
+static int opt_arena_bind = MM_BIND_ROUND_ROBIN;    // how threads pick their arena
+
+/* Placement policy: which of the free blocks that fit a request is taken */
+static int opt_policy = MM_POLICY_FIRST_FIT;        // set with mm_setopt(MM_OPT_POLICY, ...)
+static int opt_best_fit_k = 16;                     // candidates best fit compares in a class
+
+/* Giving memory back: the heap shrinks when its top free block grows past twice opt_trim_threshold (keeping
+ * opt_trim_threshold bytes of it, so a heap that breathes does not refault its pages), the pages inside free
+ * blocks of at least opt_release_threshold bytes are released. Both are off by default: pages given back fault
+ * in again when the heap regrows */
+static size_t opt_trim_threshold = 0;               // set with mm_setopt(MM_OPT_TRIM_THRESHOLD, ...)
+static size_t opt_release_threshold = 0;            // set with mm_setopt(MM_OPT_RELEASE_THRESHOLD, ...)
+static size_t opt_mmap_threshold = 128 * 1024;      // requests this large are mapped, set with MM_OPT_MMAP_THRESHOLD
+
+/* Deferred coalescing: small freed blocks stay marked allocated in quick bins, to be taken again by requests of
+ * the same size, until a bin overflows, the bins hold more than opt_defer percent of the heap, or nothing fits */
+static int opt_defer = 0;                           // set with mm_setopt(MM_OPT_DEFER, ...), 0 = coalesce right away
+
+/* Learned rounding: a request is rounded up to a larger size the workload asks for often, at most opt_round
+ * percent larger, once blocks of its own size were seen being freed while the larger size was being allocated: the
+ * freed blocks can then be taken by the larger requests. The rounding stays while the larger size stays frequent.
+ * The bytes rounding adds to an arena's live blocks stay under opt_round percent of its heap as well. mm_init starts
+ * a new table, unless MM_OPT_ROUND_KEEP is set */
+static int opt_round = 15;                          // set with mm_setopt(MM_OPT_ROUND, ...), 0 = never round
+static int opt_round_keep = 0;                      // set with mm_setopt(MM_OPT_ROUND_KEEP, 1) to keep the table
+static unsigned int round_count[ROUND_SLOTS];       // requests per granule, decaying
+static int round_flow[ROUND_SLOTS];                 // requests minus frees per granule, decaying
+static unsigned int round_total;                    // requests counted since the table was rebuilt
+static int round_busy;                              // a thread is rebuilding the table
+static unsigned short round_to[ROUND_SLOTS];        // granule each granule is rounded up to, 0 = none
+
+/* Debugging: mm_free_sized checks the size it is passed against the block and aborts on a mismatch */
+static int opt_check_size = 0;                      // set with mm_setopt(MM_OPT_CHECK_SIZE, 1), at any time
+static unsigned long heap_epoch = 0;                // bumped by mm_init, invalidates blocks cached for an old heap
+static mm_profile_t profile;                        // MM_PROFILE histograms since mm_init, updated atomically
+
+typedef struct {
+    unsigned long epoch;                            // heap_epoch the cached blocks belong to
+    arena_t *arena;                                 // arena the thread is bound to (round-robin binding)
+    unsigned int count[TCACHE_BINS];                // number of blocks in each bin
+    unsigned int round_tick;                        // requests and frees since the thread last counted one
+    void *head[TCACHE_BINS];                        // singly linked through the first payload word
+} tcache_t;
+
+static _Thread_local tcache_t tcache;
+static pthread_key_t tcache_key;                    // its destructor flushes the cache of an exiting thread
+static pthread_once_t tcache_key_once = PTHREAD_ONCE_INIT;
+
+/* Function prototypes for internal helper routines */
+
+static void *extend_heap(arena_t *a, size_t words);
+
+static void place(arena_t *a, void *bp, size_t asize);
+
+static void *find_fit(arena_t *a, size_t asize);
+
+static void *coalesce(arena_t *a, void *bp);
+
+static void printblock(void *bp);
+
+static void checkheap(int verbose);
+
+static void checkblock(void *bp);
+
+/* functions added by GROUP */
+
+static void add_to_free_list(arena_t *a, unsigned long **bp);
+
+static void remove_block_from_list(arena_t *a, unsigned long *bp);
+
+static void *find_fit_segregated(arena_t *a, size_t asize);
+
+static void *find_best_fit(arena_t *a, size_t asize, int num);
+
+static size_t adjust_size(size_t size);
+
+static void shrink_block(arena_t *a, void *bp, size_t asize);
+
+static int arena_init(arena_t *a);
+
+static arena_t *thread_arena(void);
+
+static arena_t *arena_of(void *bp);
+
+static arena_t *arena_spill(arena_t *first, arena_t *a);
+
+static void *malloc_request(size_t size);
+
+static void round_request(size_t size, size_t n);
+
+static size_t round_size(size_t size);
+
+static size_t round_allow(arena_t *a, size_t size, size_t rsize);
+
+static void round_mark(arena_t *a, void *bp, size_t size, size_t rsize);
+
+static void round_free(arena_t *a, void *bp);
+
+static void round_update(void);
+
+static void free_request(void *bp);
+
+static void *malloc_block(arena_t *a, size_t asize);
+
+static void carve_block(void *bp, size_t asize, size_t n, void **out);
+
+static int compare_addr(const void *x, const void *y);
+
+static void *realloc_block(arena_t *a, void *ptr, size_t size);
+
+static void free_block(arena_t *a, void *bp);
+
+static void free_tagged(arena_t *a, void *bp);
+
+static void check_size(void *bp, size_t size);
+
+static void release_block(arena_t *a, void *bp, char *lo, char *hi);
+
+static void quick_free(arena_t *a, void *bp);
+
+static void quick_flush(arena_t *a);
+
+static void *malloc_mapped(size_t size, size_t align);
+
+static void *realloc_mapped(void *ptr, size_t size);
+
+static void *move_to_mapping(arena_t *a, void *ptr, size_t size);
+
+static void tcache_check(void);
+
+static void *tcache_malloc(int cls);
+
+static void tcache_free(void *bp, int cls);
+
+static void tcache_flush(int bin, unsigned int n);
+
+static void tcache_key_create(void);
+
+static void tcache_exit(void *arg);
+
+static void *malloc_aligned(arena_t *a, size_t asize, size_t align);
+
+static int is_slab(arena_t *a, void *bp);
+
+static int slab_ready(size_t asize);
+
+static void slab_count(void *bp, int sign);
+
+static void *find_fit_aligned(arena_t *a, size_t asize, size_t align);
+
+static void *slab_malloc(arena_t *a, int cls);
+
+static void slab_free(arena_t *a, void *bp);
+
+static run_t *run_create(arena_t *a, int cls);
+
+static void run_destroy(arena_t *a, run_t *r);
+
+static int which_list(void *bp);
+
+static int which_list_asize(size_t size);
+
+static int next_list(arena_t *a, int num);
+
+static void check_free_list(arena_t *a);
+
+static void check_segregated(arena_t *a);
+
+#ifdef MM_PROFILE
+static void prof_add(int ev, unsigned long x);
+
+static inline unsigned long prof_ns(void);
+#endif
+
+//Group 79: An interesting visual I quote from "https://www.cs.cmu.edu/~fp/courses/15213-s05/code/18-malloc/malloc.c" for better understanding
+/*
+ * Simple allocator based on implicit free lists with boundary
+ * tag coalescing. Each block has header and footer of the form:
+ *
+ *      31                     3  2  1  0
+ *      -----------------------------------
+ *     | s  s  s  s  ... s  s  s  0  0  a/f
+ *      -----------------------------------
+ *
+ * where s are the meaningful size bits and a/f is set
+ * iff the block is allocated. The heap has the following form:
+ *
+ * begin                                                                    end
+ * heap         | 4 bytes  | 4 bytes  |                       |  4 bytes |  heap
+ *      -----------------------------------------------------------------
+ *     |        | prologue | prologue |        0 or more      | epilogue |
+ *     |  pad   | hdr(8:a) | ftr(8:a) |       user blocks     | hdr(8:a) |
+ *      -----------------------------------------------------------------
+ *     |        |       prologue      |  The blocks we store  | epilogue |
+ *     |        |         block       |        go here        | block    |
+ *
+ * The allocated prologue and epilogue blocks are overhead that
+ * eliminate edge conditions during coalescing.
+ */
+
+//// Beginning of functions
+
+/*
+ * mm_init - Initialize the memory manager: start over with empty arenas (only arena 0 is set up right away,
+ * the others on first use) and decide how many arenas threads are spread over
+ */
+int mm_init(void) {
+    number_of_arenas = 1;
+    if (opt_threads) {
+        number_of_arenas = opt_arenas ? opt_arenas : (int) sysconf(_SC_NPROCESSORS_ONLN);
+        number_of_arenas = MAX(1, MIN(number_of_arenas, MAX_ARENAS));
+    }
+
+    for (int i = 0; i < MAX_ARENAS; i++) {
+        arenas[i].heap_listp = 0;
+        arenas[i].seg_list_head = NULL;
+        arenas[i].id = i;
+        pthread_mutex_init(&arenas[i].lock, NULL);
+    }
+    next_arena = 0;
+    memset(slab_demand, 0, sizeof(slab_demand));
+    memset(slab_on, 0, sizeof(slab_on));
+    heap_epoch++;                                                               //blocks still sitting in thread caches belong to the old heap
+    memset(&profile, 0, sizeof(profile));
+    if (!opt_round_keep) {                                                      //a new heap learns anew
+        memset(round_count, 0, sizeof(round_count));
+        memset(round_flow, 0, sizeof(round_flow));
+        memset(round_to, 0, sizeof(round_to));
+        round_total = 0;
+    }
+
+    return arena_init(&arenas[0]);
+}
+
+/*
+ * arena_init - Create the empty heap of an arena: extended to reserve area for list pointers and initialize them to NULL
+ */
+static int arena_init(arena_t *a) {
+    char *heap_listp;
+
+    /* Create the initial empty heap */
+    //Group 79: mem_sbrk returns pointer to the new block of memory in the extended heap
+
+    //==============================
+    //-------------PACK-------------
+    //==============================
+    //Group 79: DSIZE = 8, 8 in binary is 1000
+    //Group 79: PACK(1000, 1) == (1000 | 0001) == 1001
+
+    //==============================
+    //-------------PUT-------------
+    //==============================
+
+    //the heads of the lists are kept in the arena: with two levels of classes they would take more heap than most blocks
+    if ((heap_listp = mem_arena_sbrk(a->id, 4 * WSIZE)) == (void *) -1)
+        return -1;
+    PUT(heap_listp, 0);                                                         /* Alignment padding */
+    a->seg_list_head = a->seg_lists;
+
+    for (int i = 0; i < number_of_lists; i++) {                                 //initialize pointer locations to NULL to avoid reading of garbage values
+        GET_LIST(a, i) = NULL;
+    }
+    a->fl_bitmap = 0;                                                           //... and mark all of them empty
+    memset(a->sl_bitmap, 0, sizeof(a->sl_bitmap));
+    a->base = mem_arena_lo(a->id);                                              //no slab runs yet
+    memset(a->runs, 0, sizeof(a->runs));
+    memset(a->run_map, 0, sizeof(a->run_map));
+    memset(a->quick, 0, sizeof(a->quick));                                      //no deferred blocks
+    memset(a->quick_count, 0, sizeof(a->quick_count));
+    a->quick_bytes = 0;
+    a->round_slack = 0;
+    memset(&a->stats, 0, sizeof(a->stats));
+
+    PUT(heap_listp + (1 * WSIZE), PACK(DSIZE, 1));                              /* Prologue header : 1001 */
+    PUT(heap_listp + (2 * WSIZE), PACK(DSIZE, 1));                              /* Prologue footer : 1001 */
+    PUT(heap_listp + (3 * WSIZE), PACK(0, PREV_ALLOC | 1));                     /* Epilogue header : 0011 */
+    heap_listp += (2 * WSIZE);
+    a->heap_listp = heap_listp;
+
+    /* Extend the empty heap with a free block of CHONKSIZE bytes */
+    if (extend_heap(a, CHONKSIZE / WSIZE) == NULL)                                 //Group 79:  If it does not extend by an even number of words, it will return NULL.
+        return -1;
+    return 0;                                                                   //Group 79: Returns 0 to main function if the heap was extended in an properly aligned manner
+}
+
+/*
+ * mm_malloc - Allocate a block with at least size bytes of payload
+ */
+void *mm_malloc(size_t size) {
+    void *bp;
+    PROF_BEGIN(t);
+
+    bp = malloc_request(size);
+    PROF_END(MM_PROF_MALLOC, t);
+    return bp;
+}
+
+/*
+ * malloc_request - mm_malloc without the profiling
+ */
+static void *malloc_request(size_t size) {
+
+    //printf("Allocating block of size: %zu bytes\n", size);
+    //checkheap(1);
+
+    size_t asize;               /* Adjusted block size */
+    size_t rsize;               /* Request size rounded up to a frequent one */
+    arena_t *a, *b, *first;
+    char *bp;                   //Group 79: Block Pointer
+
+    if (arenas[0].heap_listp == 0) {
+        printf("Initializing the Heap...");
+        mm_init();
+    }
+    /* Ignore spurious requests */
+    if (size == 0)
+        return NULL;
+
+    /* Large requests: a mapping of their own, so they neither pin nor fragment a heap */
+    if (WANTS_MAPPING(size))
+        return malloc_mapped(size, DSIZE);
+
+    /* Adjust block size to include overhead and alignment reqs. */
+    asize = adjust_size(size);
+
+    /* Small requests: an object of their slab class, from the thread cache in thread-safe mode */
+    if (size <= SLAB_MAX && slab_ready(asize)) {
+        if (!opt_threads)
+            return slab_malloc(&arenas[0], SLAB_CLASS(size));
+        return tcache_malloc(SLAB_CLASS(size));
+    }
+    rsize = round_size(size);
+
+    if (!opt_threads) {
+        a = &arenas[0];
+    } else {
+        a = thread_arena();
+        pthread_mutex_lock(&a->lock);
+    }
+    rsize = round_allow(a, size, rsize);
+    asize = adjust_size(rsize);
+    first = a;
+    bp = malloc_block(a, asize);
+    while (bp == NULL && opt_threads && (b = arena_spill(first, a)) != NULL) {
+        a = b;
+        bp = malloc_block(a, asize);
+    }
+    if (bp != NULL)
+        round_mark(a, bp, size, rsize);
+    if (size <= SLAB_MAX && bp != NULL)
+        slab_count(bp, 1);                                      //neighbours update the header's prev-alloc bit under the lock
+    if (opt_threads)
+        pthread_mutex_unlock(&a->lock);
+    return bp;
+}
+
+/*
+ * round_request - Count n requests of size bytes for the rounding table
+ */
+static void round_request(size_t size, size_t n) {
+    size_t g = (size + DSIZE - 1) / DSIZE;
+    unsigned int tick;
+
+    if (opt_round == 0 || size <= SLAB_MAX || size > ROUND_MAX)
+        return;
+    if (opt_threads) {                                          //one in ROUND_SAMPLE of the thread's requests
+        tick = tcache.round_tick;
+        tcache.round_tick += n;
+        n = tcache.round_tick / ROUND_SAMPLE - tick / ROUND_SAMPLE;
+        if (n == 0)
+            return;
+    }
+    __atomic_fetch_add(&round_count[g], n, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&round_flow[g], n, __ATOMIC_RELAXED);
+    if (__atomic_add_fetch(&round_total, n, __ATOMIC_RELAXED) >= ROUND_PERIOD &&
+        !__atomic_exchange_n(&round_busy, 1, __ATOMIC_ACQUIRE)) {  //one thread rebuilds the table
+        round_update();
+        __atomic_store_n(&round_busy, 0, __ATOMIC_RELEASE);
+    }
+}
+
+/*
+ * round_size - Count a request of size bytes and return the size the table rounds it up to, size itself if it has
+ * no entry for it
+ */
+static size_t round_size(size_t size) {
+    size_t to;
+
+    round_request(size, 1);
+    if (opt_round == 0 || size <= SLAB_MAX || size > ROUND_MAX)
+        return size;
+    to = __atomic_load_n(&round_to[(size + DSIZE - 1) / DSIZE], __ATOMIC_RELAXED);
+    return to ? to * DSIZE : size;
+}
+
+/*
+ * round_allow - rsize if arena a (locked) may take the bytes rounding size up to rsize adds, size if that would bring
+ * what rounding added to its live blocks past opt_round percent of its heap
+ */
+static size_t round_allow(arena_t *a, size_t size, size_t rsize) {
+    size_t slack = adjust_size(rsize) - adjust_size(size);
+
+    if (rsize != size && (a->round_slack + slack) * 100 > (size_t) opt_round * mem_arena_heapsize(a->id))
+        return size;
+    return rsize;
+}
+
+/*
+ * round_mark - tag the block bp just allocated from arena a (locked) for a request of size bytes rounded up to rsize
+ * with its request, so its free is counted for the request's granule and the bytes rounding added are given back
+ */
+static void round_mark(arena_t *a, void *bp, size_t size, size_t rsize) {
+    size_t slack = adjust_size(rsize) - adjust_size(size);
+
+    if (opt_round == 0 || size <= SLAB_MAX || size > ROUND_MAX || size > GET_SIZE(HDRP(bp)) - DSIZE)
+        return;                                                 //no room past the request for the word
+    PUT(REQ_WORD(bp), size | slack << 16);
+    PUT(HDRP(bp), GET(HDRP(bp)) | REQ_TAG);
+    a->round_slack += slack;
+}
+
+/*
+ * round_free - Count the free of the block bp of arena a (locked) against the granule of its request (of its size
+ * for a block without the tag) and untag it
+ */
+static void round_free(arena_t *a, void *bp) {
+    unsigned int hdr = GET(HDRP(bp)), word;
+    size_t g;
+
+    if (hdr & REQ_TAG) {
+        word = GET(REQ_WORD(bp));
+        PUT(HDRP(bp), hdr & ~REQ_TAG);
+        a->round_slack -= word >> 16;
+        g = ((word & 0xFFFF) + DSIZE - 1) / DSIZE;
+    } else {
+        g = ((hdr & ~0x7) - WSIZE + DSIZE - 1) / DSIZE;         //the largest request the block fits
+    }
+    if (opt_round == 0 || g <= SLAB_MAX / DSIZE || g >= ROUND_SLOTS)
+        return;
+    if (!opt_threads || ++tcache.round_tick % ROUND_SAMPLE == 0)
+        __atomic_fetch_sub(&round_flow[g], 1, __ATOMIC_RELAXED);
+}
+
+/*
+ * round_update - Rebuild round_to from the counts, then halve them. A granule g keeps its target while that is
+ * within opt_round percent of g's block size and has at least 1/ROUND_SHARE of the requests. Without one, it takes
+ * the largest such granule t if g has been freed more than requested (by at least half its requests) and t requested
+ * more than freed (by at least half its requests): t's requests are coming in while g's blocks go out
+ */
+static void round_update(void) {
+    unsigned int count[ROUND_SLOTS];
+    int flow[ROUND_SLOTS];
+    unsigned long total = 0;
+    size_t g, t, to, limit;
+
+    __atomic_store_n(&round_total, 0, __ATOMIC_RELAXED);
+    for (g = SLAB_MAX / DSIZE + 1; g < ROUND_SLOTS; g++) {
+        count[g] = __atomic_load_n(&round_count[g], __ATOMIC_RELAXED);
+        flow[g] = __atomic_load_n(&round_flow[g], __ATOMIC_RELAXED);
+        total += count[g];
+        __atomic_fetch_sub(&round_count[g], count[g] - count[g] / 2, __ATOMIC_RELAXED);
+        __atomic_fetch_sub(&round_flow[g], flow[g] - flow[g] / 2, __ATOMIC_RELAXED);
+    }
+    for (g = SLAB_MAX / DSIZE + 1; g < ROUND_SLOTS; g++) {
+        to = __atomic_load_n(&round_to[g], __ATOMIC_RELAXED);
+        limit = adjust_size(g * DSIZE) * (100 + opt_round) / 100;
+        if (to != 0 && (adjust_size(to * DSIZE) > limit || (unsigned long) count[to] * ROUND_SHARE < total))
+            to = 0;
+        if (to == 0 && flow[g] < 0 && -2L * flow[g] >= count[g]) {
+            for (t = g + 1; t < ROUND_SLOTS && adjust_size(t * DSIZE) <= limit; t++)
+                if ((unsigned long) count[t] * ROUND_SHARE >= total && 2L * flow[t] >= count[t] && flow[t] > 0)
+                    to = t;
+        }
+        __atomic_store_n(&round_to[g], (unsigned short) to, __ATOMIC_RELAXED);
+    }
+}
+
+/*
+ * mm_memalign - Allocate a block with at least size bytes of payload at an address that is a multiple of align (a
+ * power of two), NULL for any other align. The payload is carved out of a free block, the leading fragment goes
+ * back to the free lists.
+ */
+void *mm_memalign(size_t align, size_t size) {
+    size_t asize;
+    arena_t *a, *b, *first;
+    char *bp;
+
+    if (arenas[0].heap_listp == 0) {
+        mm_init();
+    }
+    if (size == 0 || align == 0 || (align & (align - 1)) != 0)
+        return NULL;
+    if (align <= DSIZE)                                         //every payload is DSIZE aligned
+        return mm_malloc(size);
+
+    /* Slab objects are only DSIZE aligned: a block with boundary tags, or a mapping if it may need a large one */
+    asize = adjust_size(size);
+    if (align > MAX_HEAP / 2 || WANTS_MAPPING(asize + align))
+        return malloc_mapped(size, align);
+    round_request(size, 1);
+
+    if (!opt_threads) {
+        a = &arenas[0];
+    } else {
+        a = thread_arena();
+        pthread_mutex_lock(&a->lock);
+    }
+    first = a;
+    if (a->heap_listp == 0 && arena_init(a) < 0)
+        bp = NULL;
+    else
+        bp = malloc_aligned(a, asize, align);
+    while (bp == NULL && opt_threads && (b = arena_spill(first, a)) != NULL) {
+        a = b;
+        bp = malloc_aligned(a, asize, align);
+    }
+    if (bp != NULL)
+        round_mark(a, bp, size, size);
+    if (size <= SLAB_MAX && bp != NULL)
+        slab_count(bp, 1);
+    if (opt_threads)
+        pthread_mutex_unlock(&a->lock);
+    return bp;
+}
+
+/*
+ * mm_calloc - Allocate a zeroed array of n elements of size bytes, NULL if n * size overflows. Only memory that may
+ * have been written before is cleared: a new mapping is all zeros, and so is the part of a block past the arena's
+ * clean mark (memory the heap never handed out), apart from the boundary tags the extension itself wrote there.
+ */
+void *mm_calloc(size_t n, size_t size) {
+    size_t asize, bsize = 0;
+    arena_t *a, *b, *first;
+    char *bp, *clean, *end, *dirty, *footer;
+
+    if (arenas[0].heap_listp == 0) {
+        mm_init();
+    }
+    if (n != 0 && size > SIZE_MAX / n)
+        return NULL;
+    size *= n;
+    if (size == 0)
+        return NULL;
+    if (WANTS_MAPPING(size))
+        return malloc_mapped(size, DSIZE);
+    if (size <= SLAB_MAX) {                                     //slab objects are always recycled
+        if ((bp = mm_malloc(size)) != NULL)
+            memset(bp, 0, size);
+        return bp;
+    }
+
+    asize = adjust_size(size);
+    round_request(size, 1);
+    if (!opt_threads) {
+        a = &arenas[0];
+    } else {
+        a = thread_arena();
+        pthread_mutex_lock(&a->lock);
+    }
+    first = a;
+    if (a->heap_listp == 0 && arena_init(a) < 0) {
+        bp = NULL;
+    } else {
+        clean = (char *) mem_arena_clean(a->id);                 //under the lock, once the heap is set up
+        bp = malloc_block(a, asize);
+    }
+    while (bp == NULL && opt_threads && (b = arena_spill(first, a)) != NULL) {
+        a = b;
+        clean = (char *) mem_arena_clean(a->id);
+        bp = malloc_block(a, asize);
+    }
+    if (bp != NULL) {
+        round_mark(a, bp, size, size);                          //past the request: the memsets below leave it
+        bsize = GET_SIZE(HDRP(bp));                             //under the lock: neighbours update the header
+    }
+    if (opt_threads)
+        pthread_mutex_unlock(&a->lock);
+    if (bp == NULL)
+        return NULL;
+
+    /* A fresh free block's links sit right at the clean mark, its footer at the end of the block */
+    end = bp + size;
+    dirty = MIN(end, MAX(bp, clean + 2 * POINTERSIZE));
+    footer = MAX(dirty, bp + bsize - DSIZE);
+    memset(bp, 0, dirty - bp);
+    if (end > footer)
+        memset(footer, 0, end - footer);
+    return bp;
+}
+
+/*
+* mm_free - Free a block
+*/
+void mm_free(void *bp) {
+    PROF_BEGIN(t);
+
+    free_request(bp);
+    PROF_END(MM_PROF_FREE, t);
+}
+
+/*
+ * free_request - mm_free without the profiling
+ */
+static void free_request(void *bp) {
+
+    // printf("Freeing block: ");
+    // printblock(bp);
+
+    if (bp == 0)
+        return;
+
+    if (IS_MAPPED(bp)) {
+        mem_unmap(MAP_START(bp));
+        return;
+    }
+
+    arena_t *a;
+    if (arenas[0].heap_listp == 0) {
+        mm_init();
+    }
+
+    a = opt_threads ? arena_of(bp) : &arenas[0];                //blocks always go back to the arena they came from
+    if (!is_slab(a, bp))
+        free_tagged(a, bp);
+    else if (!opt_threads)
+        slab_free(a, bp);
+    else
+        tcache_free(bp, RUN_OF(bp)->cls);
+}
+
+/*
+ * mm_free_sized - Free a block the caller knows the payload size of (as last passed to mm_malloc or mm_realloc):
+ * larger blocks skip the slab lookup, and in thread-safe mode a slab object goes to the thread cache of its class
+ * without the run header being read (slab_free needs the run's bitmap anyway)
+ */
+void mm_free_sized(void *bp, size_t size) {
+    arena_t *a;
+
+    if (bp == 0)
+        return;
+    if (opt_check_size)
+        check_size(bp, size);
+
+    if (IS_MAPPED(bp)) {
+        mem_unmap(MAP_START(bp));
+        return;
+    }
+    if (arenas[0].heap_listp == 0) {
+        mm_init();
+    }
+
+    a = opt_threads ? arena_of(bp) : &arenas[0];
+    if (size > SLAB_MAX || !is_slab(a, bp))
+        free_tagged(a, bp);
+    else if (!opt_threads)
+        slab_free(a, bp);
+    else
+        tcache_free(bp, SLAB_CLASS(size));
+}
+
+/*
+ * free_tagged - free the block bp with boundary tags into its arena a: deferred if it is small and deferring is on
+ */
+static void free_tagged(arena_t *a, void *bp) {
+    if (opt_threads)
+        pthread_mutex_lock(&a->lock);
+    slab_count(bp, -1);
+    round_free(a, bp);
+    if (opt_defer && GET_SIZE(HDRP(bp)) <= QUICK_MAX)
+        quick_free(a, bp);
+    else
+        free_block(a, bp);
+    if (opt_threads)
+        pthread_mutex_unlock(&a->lock);
+}
+
+/*
+ * check_size - abort if size cannot be the payload size of the allocated block bp (MM_OPT_CHECK_SIZE)
+ */
+static void check_size(void *bp, size_t size) {
+    arena_t *a;
+    size_t room;
+    int ok;
+
+    if (IS_MAPPED(bp)) {
+        room = MAP_LEN(bp) - MAP_LEAD(bp);
+        ok = 1;
+    } else if (is_slab(arena_of(bp), bp)) {
+        room = RUN_OF(bp)->size;
+        ok = (size <= SLAB_MAX && SLAB_CLASS(size) == RUN_OF(bp)->cls);
+    } else {
+        a = opt_threads ? arena_of(bp) : &arenas[0];
+        if (opt_threads)
+            pthread_mutex_lock(&a->lock);                       //neighbours update the header's prev-alloc bit
+        room = GET_SIZE(HDRP(bp)) - WSIZE;
+        ok = GET_ALLOC(HDRP(bp));
+        if (opt_threads)
+            pthread_mutex_unlock(&a->lock);
+    }
+    if (!ok || size == 0 || size > room) {
+        fprintf(stderr, "mm_free_sized: size %zu does not match block %p (%zu bytes%s)\n", size, bp, room,
+                ok ? "" : ", other class or not allocated");
+        abort();
+    }
+}
+
+/*
+ * mm_malloc_batch - Allocate count blocks of at least size bytes of payload each into out, several at a time from
+ * one free region; returns how many were allocated (fewer than count only when memory runs out)
+ */
+size_t mm_malloc_batch(size_t size, size_t count, void **out) {
+    size_t asize, done, n;
+    arena_t *a, *b, *first;
+    char *bp;
+
+    if (arenas[0].heap_listp == 0) {
+        mm_init();
+    }
+    if (size == 0)
+        return 0;
+
+    /* Mapped and slab blocks do not come from a free region: one at a time */
+    asize = adjust_size(size);
+    if (WANTS_MAPPING(size) || (size <= SLAB_MAX && slab_ready(asize))) {
+        for (done = 0; done < count; done++)
+            if ((out[done] = mm_malloc(size)) == NULL)
+                break;
+        return done;
+    }
+
+    if (!opt_threads) {
+        a = &arenas[0];
+    } else {
+        a = thread_arena();
+        pthread_mutex_lock(&a->lock);
+    }
+    first = a;
+    for (done = 0; done < count; done += n) {
+        n = MIN(count - done, MAX(1, BATCH_BYTES / asize));
+        bp = malloc_block(a, n * asize);
+        while (bp == NULL && opt_threads && (b = arena_spill(first, a)) != NULL) {
+            a = b;
+            bp = malloc_block(a, n * asize);
+        }
+        if (bp == NULL)
+            break;
+        carve_block(bp, asize, n, out + done);
+        round_request(size, n);
+        for (size_t i = 0; i < n; i++) {
+            round_mark(a, out[done + i], size, size);
+            if (size <= SLAB_MAX)
+                slab_count(out[done + i], 1);
+        }
+    }
+    if (opt_threads)
+        pthread_mutex_unlock(&a->lock);
+    return done;
+}
+
+/*
+ * carve_block - cut the allocated block bp into n allocated blocks of asize bytes (the last one keeps what place
+ * left over) and store their pointers in out
+ */
+static void carve_block(void *bp, size_t asize, size_t n, void **out) {
+    size_t bsize = GET_SIZE(HDRP(bp));
+
+    PUT(HDRP(bp), PACK(asize, GET_PREV_ALLOC(HDRP(bp)) | 1));
+    out[0] = bp;
+    for (size_t i = 1; i < n; i++) {
+        bp = NEXT_BLKP(bp);
+        PUT(HDRP(bp), PACK(asize, PREV_ALLOC | 1));
+        out[i] = bp;
+    }
+    PUT(HDRP(bp), PACK(bsize - (n - 1) * asize, GET_PREV_ALLOC(HDRP(bp)) | 1));
+}
+
+/*
+ * mm_free_batch - Free the n blocks in ptrs (reordered in place): slab and mapped blocks are freed one by one, the
+ * others sorted by address so that runs of blocks adjacent in a heap go back to their arena as one block and
+ * coalesce once
+ */
+void mm_free_batch(void **ptrs, size_t n) {
+    arena_t *a, *locked = NULL;
+    size_t i, j, m, size;
+    char *bp;
+
+    if (arenas[0].heap_listp == 0) {
+        mm_init();
+    }
+
+    /* Keep the blocks with boundary tags and sort them by address */
+    for (i = m = 0; i < n; i++) {
+        if (ptrs[i] == NULL)
+            continue;
+        if (IS_MAPPED(ptrs[i]) || is_slab(arena_of(ptrs[i]), ptrs[i]))
+            mm_free(ptrs[i]);
+        else
+            ptrs[m++] = ptrs[i];
+    }
+    qsort(ptrs, m, sizeof(*ptrs), compare_addr);
+
+    for (i = 0; i < m; i = j) {
+        bp = ptrs[i];
+        a = arena_of(bp);
+        if (opt_threads && a != locked) {                       //keep the lock while the blocks stay in one arena
+            if (locked != NULL)
+                pthread_mutex_unlock(&locked->lock);
+            pthread_mutex_lock(&a->lock);
+            locked = a;
+        }
+        slab_count(bp, -1);
+        round_free(a, bp);
+        size = GET_SIZE(HDRP(bp));
+        for (j = i + 1; j < m && ptrs[j] == bp + size; j++) {
+            slab_count(ptrs[j], -1);
+            round_free(a, ptrs[j]);
+            size += GET_SIZE(HDRP(ptrs[j]));
+        }
+        PUT(HDRP(bp), PACK(size, GET_PREV_ALLOC(HDRP(bp)) | 1));
+        if (opt_defer && size <= QUICK_MAX)
+            quick_free(a, bp);
+        else
+            free_block(a, bp);
+    }
+    if (locked != NULL)
+        pthread_mutex_unlock(&locked->lock);
+}
+
+/*
+ * compare_addr - qsort comparator of mm_free_batch: orders block pointers by address
+ */
+static int compare_addr(const void *x, const void *y) {
+    char *p = *(char * const *) x, *q = *(char * const *) y;
+
+    return (p > q) - (p < q);
+}
+
+/*
+ * mm_setopt - set an allocator option (see mm.h); returns 1 on success, 0 for an unknown option or bad value
+ */
+int mm_setopt(int param, long value) {
+    switch (param) {
+        case MM_OPT_THREADS:
+            opt_threads = (value != 0);
+            return 1;
+        case MM_OPT_ARENAS:
+            if (value < 0 || value > MAX_ARENAS)
+                return 0;
+            opt_arenas = value;
+            return 1;
+        case MM_OPT_ARENA_BIND:
+            if (value != MM_BIND_ROUND_ROBIN && value != MM_BIND_CPU)
+                return 0;
+            opt_arena_bind = value;
+            return 1;
+        case MM_OPT_POLICY:
+            if (value != MM_POLICY_FIRST_FIT && value != MM_POLICY_BEST_FIT && value != MM_POLICY_ADDRESS)
+                return 0;
+            opt_policy = value;
+            return 1;
+        case MM_OPT_BEST_FIT_K:
+            if (value <= 0 || value > INT_MAX)
+                return 0;
+            opt_best_fit_k = value;
+            return 1;
+        case MM_OPT_TRIM_THRESHOLD:
+            if (value < 0)
+                return 0;
+            opt_trim_threshold = value;
+            return 1;
+        case MM_OPT_RELEASE_THRESHOLD:
+            if (value < 0)
+                return 0;
+            opt_release_threshold = value;
+            return 1;
+        case MM_OPT_MMAP_THRESHOLD:
+            if (value < 0)
+                return 0;
+            opt_mmap_threshold = value;
+            return 1;
+        case MM_OPT_DEFER:
+            if (value < 0 || value > 100)
+                return 0;
+            opt_defer = value;
+            return 1;
+        case MM_OPT_CHECK_SIZE:
+            opt_check_size = (value != 0);
+            return 1;
+        case MM_OPT_ROUND:
+            if (value < 0 || value > 100)
+                return 0;
+            opt_round = value;
+            return 1;
+        case MM_OPT_ROUND_KEEP:
+            opt_round_keep = (value != 0);
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+/*
+ * mm_get_stats - Snapshot of the counters of all arenas. The arenas are locked one at a time, so in thread-safe
+ * mode the sums may mix moments, but each arena's numbers are consistent.
+ */
+void mm_get_stats(mm_stats_t *st) {
+    arena_t *a;
+
+    memset(st, 0, sizeof(*st));
+    for (int i = 0; i < MAX_ARENAS; i++) {
+        a = &arenas[i];
+        if (opt_threads)
+            pthread_mutex_lock(&a->lock);
+        if (a->heap_listp != 0) {
+            for (int num = 0; num < MM_STATS_LISTS; num++) {
+                st->list_blocks[num] += a->stats.list_blocks[num];
+                st->list_bytes[num] += a->stats.list_bytes[num];
+                st->free_bytes += a->stats.list_bytes[num];
+            }
+            st->heap_bytes += mem_arena_heapsize(a->id);
+            st->deferred_bytes += a->quick_bytes;
+            st->extends += a->stats.extends;
+            st->splits += a->stats.splits;
+            st->coalesces += a->stats.coalesces;
+            st->searches += a->stats.searches;
+            st->search_steps += a->stats.search_steps;
+        }
+        if (opt_threads)
+            pthread_mutex_unlock(&a->lock);
+    }
+    st->in_use_bytes = st->heap_bytes - st->free_bytes - st->deferred_bytes;
+    st->mapped_bytes = mem_mapsize();
+}
+
+/*
+ * mm_get_profile - Snapshot of the profiling histograms, 0 if the package was compiled without MM_PROFILE
+ */
+int mm_get_profile(mm_profile_t *p) {
+#ifdef MM_PROFILE
+    for (int ev = 0; ev < MM_PROF_EVENTS; ev++)
+        for (int b = 0; b < MM_PROF_BUCKETS; b++)
+            p->count[ev][b] = __atomic_load_n(&profile.count[ev][b], __ATOMIC_RELAXED);
+    return 1;
+#else
+    memset(p, 0, sizeof(*p));
+    return 0;
+#endif
+}
+
+#ifdef MM_PROFILE
+/*
+ * prof_add - count x in the histogram of event ev: values below 4 have buckets of their own, above that the most
+ * significant bit picks four buckets and the next two bits one of them
+ */
+static void prof_add(int ev, unsigned long x) {
+    int b = (x < 4) ? (int) x : 4 * (MSB(x) - 1) + (int) ((x >> (MSB(x) - 2)) & 3);
+
+    __atomic_fetch_add(&profile.count[ev][b], 1, __ATOMIC_RELAXED);
+}
+
+/*
+ * prof_ns - ticks where there is no time stamp counter: nanoseconds of the monotonic clock
+ */
+static inline unsigned long prof_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+#endif
+
+/*
+ * thread_arena - arena the calling thread allocates from: bound round-robin on the thread's first allocation
+ * (per heap), or looked up from the CPU the thread currently runs on
+ */
+static arena_t *thread_arena(void) {
+    int cpu;
+
+    if (opt_arena_bind == MM_BIND_CPU) {
+        cpu = sched_getcpu();
+        return &arenas[(cpu < 0 ? 0 : cpu) % number_of_arenas];
+    }
+
+    tcache_check();
+    if (tcache.arena == NULL)
+        tcache.arena = &arenas[__atomic_fetch_add(&next_arena, 1, __ATOMIC_RELAXED) % number_of_arenas];
+    return tcache.arena;
+}
+
+/*
+ * arena_spill - arena a (locked) is out of memory: unlock it and return the next arena after it, locked and set
+ * up, that the thread allocates from from now on (round-robin binding). Arenas threads are not spread over are
+ * taken too. NULL, with a locked again, once every arena from first on was tried. One lock is held at a time
+ */
+static arena_t *arena_spill(arena_t *first, arena_t *a) {
+    arena_t *b = a;
+
+    pthread_mutex_unlock(&a->lock);
+    while ((b = &arenas[(b->id + 1) % MAX_ARENAS]) != first) {
+        pthread_mutex_lock(&b->lock);
+        if (b->heap_listp != 0 || arena_init(b) == 0) {
+            if (opt_arena_bind != MM_BIND_CPU)
+                tcache.arena = b;
+            return b;
+        }
+        pthread_mutex_unlock(&b->lock);
+    }
+    pthread_mutex_lock(&a->lock);
+    return NULL;
+}
+
+/*
+ * arena_of - arena owning the block bp, found from the memlib arena its address lies in
+ */
+static arena_t *arena_of(void *bp) {
+    return &arenas[mem_arena_of(bp)];
+}
+
+/*
+ * malloc_block - allocate a block of asize bytes from arena a (locked): a deferred block of that size, else first
+ * fit in the segregated lists (after coalescing the deferred blocks if need be), extend the heap if nothing fits
+ */
+static void *malloc_block(arena_t *a, size_t asize) {
+    size_t extendsize;          /* Amount to extend heap if no fit */
+    char *bp;
+
+    if (a->heap_listp == 0 && arena_init(a) < 0)                       //arenas other than 0 are set up on first use
+        return NULL;
+
+    /* A deferred block of exactly this size, still marked allocated */
+    if (asize <= QUICK_MAX && (bp = a->quick[asize / DSIZE]) != NULL) {
+        a->quick[asize / DSIZE] = *(void **) bp;
+        a->quick_count[asize / DSIZE]--;
+        a->quick_bytes -= asize;
+        return bp;
+    }
+
+    /* Search the free list for a fit, coalesce the deferred blocks if there is none */
+    PROF_MARK(steps, a->stats.search_steps);
+    if ((bp = find_fit_segregated(a, asize)) == NULL && a->quick_bytes > 0) {
+        quick_flush(a);
+        bp = find_fit_segregated(a, asize);
+    }
+    PROF_ADD(MM_PROF_SEARCH, a->stats.search_steps - steps);
+    if (bp != NULL) {
+        place(a, bp, asize);
+        return bp;
+    }
+
+    /* No fit found. Get more memory and place the block */
+    extendsize = MAX(asize, CHONKSIZE);
+    if ((bp = extend_heap(a, extendsize / WSIZE)) == NULL)
+        return NULL;
+
+    place(a, bp, asize);
+
+    return bp;
+}
+
+/*
+ * free_block - give an allocated block back to its arena a (locked) and coalesce it with its neighbours; large
+ * free blocks give their memory back to the system
+ */
+static void free_block(arena_t *a, void *bp) {
+    size_t size = GET_SIZE(HDRP(bp));
+    char *lo = HDRP(bp), *hi = lo + size;                   //what may still be in memory: this block and the free
+                                                            //neighbours too small to have been released
+    if (!GET_PREV_ALLOC(HDRP(bp)) && GET_SIZE(HDRP(PREV_BLKP(bp))) < opt_release_threshold)
+        lo = HDRP(PREV_BLKP(bp));
+    if (!GET_ALLOC(HDRP(NEXT_BLKP(bp))) && GET_SIZE(HDRP(NEXT_BLKP(bp))) < opt_release_threshold)
+        hi += GET_SIZE(HDRP(NEXT_BLKP(bp)));
+
+    PUT(HDRP(bp), PACK(size, GET_PREV_ALLOC(HDRP(bp))));
+    PUT(FTRP(bp), PACK(size, 0));
+    CLEAR_PREV_ALLOC(HDRP(NEXT_BLKP(bp)));
+    bp = coalesce(a, bp);
+    if (opt_trim_threshold || opt_release_threshold)
+        release_block(a, bp, lo, hi);
+}
+
+/*
+ * quick_free - defer freeing the small block bp of arena a (locked): it goes into the quick bin of its size; all
+ * deferred blocks are coalesced once the bin is full or the bins hold too much of the heap
+ */
+static void quick_free(arena_t *a, void *bp) {
+    size_t size = GET_SIZE(HDRP(bp));
 
-/* Global variables */
-static char *heap_listp = 0;                        /* Pointer to first block */
-static void **seg_list_head = NULL;                 // pointer to location in memory where the heads of the lists are stored, other lists stored directly below
-static int number_of_lists = 19;                    // total number of lists located on HEAP
+    *(void **) bp = a->quick[size / DSIZE];
+    a->quick[size / DSIZE] = bp;
+    a->quick_bytes += size;
+    if (++a->quick_count[size / DSIZE] > QUICK_COUNT
+        || a->quick_bytes * 100 > opt_defer * mem_arena_heapsize(a->id))
+        quick_flush(a);
+}
 
-/* Function prototypes for internal helper routines */
+/*
+ * quick_flush - free and coalesce all deferred blocks of arena a (locked)
+ */
+static void quick_flush(arena_t *a) {
+    void *bp;
 
-static void *extend_heap(size_t words);
+    for (int i = 0; i < QUICK_BINS; i++) {
+        while ((bp = a->quick[i]) != NULL) {
+            a->quick[i] = *(void **) bp;
+            free_block(a, bp);
+        }
+        a->quick_count[i] = 0;
+    }
+    a->quick_bytes = 0;
+}
 
-static void place(void *bp, size_t asize);
+/*
+ * release_block - return the memory of the free block bp of arena a (locked) to the system: at the top of the heap
+ * the heap shrinks to leave opt_trim_threshold bytes of it, elsewhere the whole pages in [lo, hi) are released, the
+ * rest of the block was released when it was freed. The links and the footer stay, so the block remains on its free
+ * list.
+ */
+static void release_block(arena_t *a, void *bp, char *lo, char *hi) {
+    size_t size = GET_SIZE(HDRP(bp));
+    size_t page = mem_pagesize();
 
-static void *find_fit(size_t asize);
+    size_t keep = MAX(DSIZE * ((opt_trim_threshold + DSIZE - 1) / DSIZE), MIN_SIZE);
 
-static void *coalesce(void *bp);
+    if (opt_trim_threshold && size >= 2 * keep && GET_SIZE(HDRP(NEXT_BLKP(bp))) == 0) {
+        remove_block_from_list(a, (unsigned long *) bp);
+        PUT(HDRP(bp), PACK(keep, GET_PREV_ALLOC(HDRP(bp))));
+        PUT(FTRP(bp), PACK(keep, 0));
+        PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 1));                       /* New epilogue header, previous block is free */
+        add_to_free_list(a, (unsigned long **) bp);
+        mem_arena_sbrk(a->id, -(intptr_t) (size - keep));
+        return;
+    }
 
-static void printblock(void *bp);
+    if (opt_release_threshold && size >= opt_release_threshold) {
+        lo = MAX((char *) bp + 2 * POINTERSIZE, lo);
+        hi = MIN((char *) bp + size - DSIZE, hi);
+        if (hi - lo >= (long) page)
+            mem_release(lo, hi - lo);
+    }
+}
 
-static void checkheap(int verbose);
+/*
+ * malloc_mapped - allocate a block with at least size bytes of payload in a mapping of its own, at an address
+ * aligned to align (a power of two): past the header, or as far into the mapping as it takes
+ */
+static void *malloc_mapped(size_t size, size_t align) {
+    size_t pad = (align > MAP_HDR) ? align : 0;                         //most the payload can move for its alignment
+    size_t len, lead;
+    char *p;
 
-static void checkblock(void *bp);
+    if (size > SIZE_MAX - MAP_HDR - pad - mem_pagesize())
+        return NULL;
+    len = (size + MAP_HDR + pad + mem_pagesize() - 1) & ~(mem_pagesize() - 1);
+    if ((p = mem_map(len)) == (void *) -1)
+        return NULL;
+    lead = MAP_HDR + (-(unsigned long) (p + MAP_HDR) & (align - 1));
+    MAP_LEN(p + lead) = len;
+    MAP_LEAD(p + lead) = lead;
+    return p + lead;
+}
 
-/* functions added by GROUP */
+/*
+ * realloc_mapped - resize the mapped block ptr: a request that is still large resizes the mapping (the system may
+ * move it without copying), a small one moves the payload to a heap
+ */
+static void *realloc_mapped(void *ptr, size_t size) {
+    size_t lead = MAP_LEAD(ptr), len;
+    char *p;
 
-static void add_to_free_list(unsigned long **bp);
+    if (size > SIZE_MAX - lead - mem_pagesize())
+        return NULL;
+    len = (size + lead + mem_pagesize() - 1) & ~(mem_pagesize() - 1);
+    if (len == MAP_LEN(ptr))
+        return ptr;
+    if (size < opt_mmap_threshold / 2) {                                //hysteresis: don't bounce around the threshold
+        if ((p = mm_malloc(size)) == NULL)
+            return NULL;
+        memcpy(p, ptr, size);
+        mem_unmap(MAP_START(ptr));
+        return p;
+    }
+    if ((p = mem_remap(MAP_START(ptr), len)) == (void *) -1)
+        return NULL;
+    MAP_LEN(p + lead) = len;
+    return p + lead;
+}
 
-static void remove_block_from_list(unsigned long *bp);
+/*
+ * move_to_mapping - move the heap block ptr of arena a (locked) to a new mapping with size bytes of payload
+ */
+static void *move_to_mapping(arena_t *a, void *ptr, size_t size) {
+    void *newptr;
+
+    if ((newptr = malloc_mapped(size, DSIZE)) == NULL)
+        return NULL;
+    memcpy(newptr, ptr, MIN(size, GET_SIZE(HDRP(ptr)) - WSIZE));
+    free_block(a, ptr);
+    return newptr;
+}
 
-static void *find_fit_segregated(size_t asize);
+/*
+ * tcache_check - drop the calling thread's cache and arena binding if they belong to a heap from before the
+ * last mm_init
+ */
+static void tcache_check(void) {
+    if (tcache.epoch != heap_epoch) {
+        memset(&tcache, 0, sizeof(tcache));
+        tcache.epoch = heap_epoch;
+        pthread_once(&tcache_key_once, tcache_key_create);
+        pthread_setspecific(tcache_key, &tcache);                   //so the blocks go back when the thread exits
+    }
+}
 
-static int which_list(void *bp);
+/*
+ * tcache_key_create - create the key whose destructor flushes a thread's cache when it exits
+ */
+static void tcache_key_create(void) {
+    pthread_key_create(&tcache_key, tcache_exit);
+}
 
-static int which_list_asize(int size);
+/*
+ * tcache_exit - give the blocks cached by an exiting thread back to their arenas, unless they belong to an old heap
+ */
+static void tcache_exit(void *arg) {
+    (void) arg;                                                     //&tcache, still the exiting thread's
+    if (tcache.epoch != heap_epoch)
+        return;
+    for (int bin = 0; bin < TCACHE_BINS; bin++)
+        tcache_flush(bin, tcache.count[bin]);
+}
 
-static int which_list_asize_alternative(int size);
+/*
+ * tcache_malloc - take a slab object of class cls from the calling thread's cache without locking; an empty bin is
+ * refilled with TCACHE_BATCH objects from the thread's arena under one lock
+ */
+static void *tcache_malloc(int cls) {
+    int bin = cls;
+    arena_t *a, *b, *first;
+    void *bp;
 
-static int depth(int depth, int size);
+    tcache_check();                                                 //heap was re-initialized: drop the stale blocks
 
-static void check_free_list();
+    if ((bp = tcache.head[bin]) != NULL) {
+        tcache.head[bin] = *(void **) bp;
+        tcache.count[bin]--;
+        return bp;
+    }
 
-static void check_segregated();
+    a = first = thread_arena();
+    pthread_mutex_lock(&a->lock);
+    bp = slab_malloc(a, cls);
+    while (bp == NULL && (b = arena_spill(first, a)) != NULL) {
+        a = b;
+        bp = slab_malloc(a, cls);
+    }
+    for (int i = 1; bp != NULL && i < TCACHE_BATCH; i++) {
+        void *extra = slab_malloc(a, cls);
+        if (extra == NULL)
+            break;
+        *(void **) extra = tcache.head[bin];
+        tcache.head[bin] = extra;
+        tcache.count[bin]++;
+    }
+    pthread_mutex_unlock(&a->lock);
+    return bp;
+}
 
-//Group 79: An interesting visual I quote from "https://www.cs.cmu.edu/~fp/courses/15213-s05/code/18-malloc/malloc.c" for better understanding
 /*
- * Simple allocator based on implicit free lists with boundary
- * tag coalescing. Each block has header and footer of the form:
- *
- *      31                     3  2  1  0
- *      -----------------------------------
- *     | s  s  s  s  ... s  s  s  0  0  a/f
- *      -----------------------------------
- *
- * where s are the meaningful size bits and a/f is set
- * iff the block is allocated. The heap has the following form:
- *
- * begin                                                                    end
- * heap         | 4 bytes  | 4 bytes  |                       |  4 bytes |  heap
- *      -----------------------------------------------------------------
- *     |        | prologue | prologue |        0 or more      | epilogue |
- *     |  pad   | hdr(8:a) | ftr(8:a) |       user blocks     | hdr(8:a) |
- *      -----------------------------------------------------------------
- *     |        |       prologue      |  The blocks we store  | epilogue |
- *     |        |         block       |        go here        | block    |
- *
- * The allocated prologue and epilogue blocks are overhead that
- * eliminate edge conditions during coalescing.
+ * tcache_free - put a slab object of class cls into the calling thread's cache without locking; a full bin first
+ * gives TCACHE_BATCH objects back to their arenas under one lock
  */
+static void tcache_free(void *bp, int cls) {
+    int bin = cls;
 
-//// Beginning of functions
+    tcache_check();
+
+    if (tcache.count[bin] >= TCACHE_COUNT)
+        tcache_flush(bin, TCACHE_BATCH);
+
+    *(void **) bp = tcache.head[bin];
+    tcache.head[bin] = bp;
+    tcache.count[bin]++;
+}
 
 /*
- * mm_init - Initialize the memory manager: extended to reserve area for list pointers and initialize them to NULL
+ * tcache_flush - give the first n objects of the calling thread's bin back to their arenas (a bin can hold objects
+ * of several), taking each lock once per run of objects of the same arena
  */
-int mm_init(void) {
-
-    /* Create the initial empty heap */
-    //Group 79: mem_sbrk returns pointer to the new block of memory in the extended heap
+static void tcache_flush(int bin, unsigned int n) {
+    arena_t *locked = NULL;
+
+    for (unsigned int i = 0; i < n; i++) {
+        void *old = tcache.head[bin];
+        arena_t *a = arena_of(old);
+        tcache.head[bin] = *(void **) old;
+        if (a != locked) {
+            if (locked != NULL)
+                pthread_mutex_unlock(&locked->lock);
+            pthread_mutex_lock(&a->lock);
+            locked = a;
+        }
+        slab_free(a, old);
+    }
+    if (locked != NULL)
+        pthread_mutex_unlock(&locked->lock);
+    tcache.count[bin] -= n;
+}
 
-    //==============================
-    //-------------PACK-------------
-    //==============================
-    //Group 79: DSIZE = 8, 8 in binary is 1000
-    //Group 79: PACK(1000, 1) == (1000 | 0001) == 1001
+/*
+ * malloc_aligned - allocate a block of asize bytes from arena a (locked) whose payload is aligned to align (a power
+ * of two): take a free block the aligned block fits in, or a new one big enough for it at any offset; the leading
+ * fragment goes back to the free lists, shrink_block cuts off the tail
+ */
+static void *malloc_aligned(arena_t *a, size_t asize, size_t align) {
+    char *bp, *abp;
+    size_t csize, lead;
+
+    PROF_MARK(steps, a->stats.search_steps);
+    bp = find_fit_aligned(a, asize, align);
+    PROF_ADD(MM_PROF_SEARCH, a->stats.search_steps - steps);
+    if (bp != NULL)
+        place(a, bp, GET_SIZE(HDRP(bp)));                               //whole block, split below
+    else if ((bp = malloc_block(a, asize + align + MIN_SIZE)) == NULL)
+        return NULL;
 
-    //==============================
-    //-------------PUT-------------
-    //==============================
+    abp = (char *) (((unsigned long) bp + align - 1) & ~(unsigned long) (align - 1));
+    if (abp != bp && abp - bp < MIN_SIZE)                               //leading fragment too small for a free block
+        abp += align;
+    lead = abp - bp;
+    if (lead > 0) {
+        csize = GET_SIZE(HDRP(bp));
+        PUT(HDRP(abp), PACK(csize - lead, 1));                          //previous block (the fragment) is free
+        PUT(HDRP(bp), PACK(lead, GET_PREV_ALLOC(HDRP(bp))));
+        PUT(FTRP(bp), PACK(lead, 0));
+        a->stats.splits++;
+        coalesce(a, bp);
+    }
+    shrink_block(a, abp, asize);
+    return abp;
+}
 
-    //reserves space between heap header (0,0) and prologue (8,1) for the pointers to lists
-    if ((heap_listp = mem_sbrk(4 * WSIZE + SIZE_OF_SEG_STORAGE)) == (void *) -1)
-        return -1;
-    PUT(heap_listp, 0);                                                         /* Alignment padding */
-    seg_list_head = (typeof(seg_list_head)) (heap_listp + (1 * WSIZE));         //set seg_list_head to first byte after alignment padding
+/*
+ * find_fit_aligned - a free block of arena a that holds a block of asize bytes at a payload address aligned to
+ * align, with room for a free leading fragment; looks at FIT_SCAN blocks in asize's class and the next non-empty one
+ */
+static void *find_fit_aligned(arena_t *a, size_t asize, size_t align) {
+    unsigned long **bp;
+    unsigned long lead;
+    int num = which_list_asize(asize);
 
-    for (int i = 0; i < number_of_lists; i++) {                                 //initialize pointer locations to NULL to avoid reading of garbage values
-        GET_LIST(i) = NULL;
+    a->stats.searches++;
+    for (int pass = 0; pass < 2 && num >= 0; pass++, num = next_list(a, num + 1)) {
+        bp = (typeof(bp)) GET_LIST(a, num);
+        for (int n = 0; bp != NULL && n < FIT_SCAN; bp = (typeof(bp)) GET_NEXT(bp), n++) {
+            a->stats.search_steps++;
+            lead = -(unsigned long) bp & (align - 1);
+            if (lead != 0 && lead < MIN_SIZE)
+                lead += align;
+            if (lead + asize <= GET_SIZE(HDRP(bp)))
+                return bp;
+        }
     }
+    return NULL;
+}
 
-    PUT(heap_listp + (1 * WSIZE + SIZE_OF_SEG_STORAGE), PACK(DSIZE, 1));        /* Prologue header : 1001 */
-    PUT(heap_listp + (2 * WSIZE + SIZE_OF_SEG_STORAGE), PACK(DSIZE, 1));        /* Prologue footer : 1001 */
-    PUT(heap_listp + (3 * WSIZE + SIZE_OF_SEG_STORAGE), PACK(0, 1));            /* Epilogue header : 0001 */
-    heap_listp += (2 * WSIZE + SIZE_OF_SEG_STORAGE);
+/*
+ * is_slab - is bp an object in a slab run of arena a (as opposed to a block with boundary tags). Called without the
+ * lock: the bit of bp's page can't change while bp is allocated, but others in the same word can, so the word is
+ * accessed atomically.
+ */
+static int is_slab(arena_t *a, void *bp) {
+    unsigned long page = ((char *) bp - a->base) / RUN_SIZE;
+    return (__atomic_load_n(&a->run_map[page / 64], __ATOMIC_RELAXED) >> (page % 64)) & 1;
+}
 
+/*
+ * slab_ready - are requests that need a block of asize bytes served from the runs of their slab class
+ */
+static int slab_ready(size_t asize) {
+    return __atomic_load_n(&slab_on[SLAB_KEY(asize)], __ATOMIC_RELAXED);
+}
 
-    /* Extend the empty heap with a free block of CHONKSIZE bytes */
-    if (extend_heap(CHONKSIZE / WSIZE) == NULL)                                 //Group 79:  If it does not extend by an even number of words, it will return NULL.
-        return -1;
-    return 0;                                                                   //Group 79: Returns 0 to main function if the heap was extended in an properly aligned manner
+/*
+ * slab_count - count the small block bp with boundary tags as allocated (sign 1) or freed (sign -1) for its slab
+ * class, and switch the class to runs once enough of them are live
+ */
+static void slab_count(void *bp, int sign) {
+    int size = GET_SIZE(HDRP(bp));
+    int key;
+
+    if (size - DSIZE > SLAB_MAX)
+        return;
+    key = SLAB_KEY(size);
+    if (__atomic_load_n(&slab_on[key], __ATOMIC_RELAXED))
+        return;
+    if (__atomic_add_fetch(&slab_demand[key], sign * size, __ATOMIC_RELAXED) >= RUN_SIZE)
+        __atomic_store_n(&slab_on[key], 1, __ATOMIC_RELAXED);
 }
 
 /*
- * mm_malloc - Allocate a block with at least size bytes of payload
+ * slab_malloc - take a free object of class cls from arena a (locked): the first free one of the first run that has
+ * any, a new run if none has
  */
-void *mm_malloc(size_t size) {
+static void *slab_malloc(arena_t *a, int cls) {
+    run_t *r = a->runs[cls];
+    int w, i;
 
-    //printf("Allocating block of size: %zu bytes\n", size);
-    //checkheap(1);
+    if (r == NULL && (r = run_create(a, cls)) == NULL)
+        return NULL;
 
-    size_t asize;               /* Adjusted block size */
-    size_t extendsize;          /* Amount to extend heap if no fit */
-    char *bp;                   //Group 79: Block Pointer
+    for (w = 0; r->map[w] == 0; w++)
+        ;
+    i = w * 64 + __builtin_ctzl(r->map[w]);
+    r->map[w] &= ~(1UL << (i % 64));
 
-    if (heap_listp == 0) {
-        printf("Initializing the Heap...");
-        mm_init();
+    if (--r->nfree == 0) {                                              //run is full: take it off the class list
+        a->runs[cls] = r->next;
+        if (r->next != NULL)
+            r->next->prev = NULL;
     }
-    /* Ignore spurious requests */
-    if (size == 0)
-        return NULL;
+    return (char *) r + sizeof(run_t) + (size_t) i * r->size;
+}
 
-    /* Adjust block size to include overhead and alignment reqs. */
-    if (size <= DSIZE)          //Group 79: size <= 8 bytes
-        asize = MIN_SIZE;       //Group 79: asize = 24 bytes
-    else
-        asize = DSIZE * ((size + (DSIZE) + (DSIZE - 1)) /
-                         DSIZE); //Group 79: asize = adjusted size to satisfy alignment requirement
-
-    //used to optimize for the two binary tests: Zachary Hynes had email correspondence with WAN Hu about it
-    if (size == 112)
-        asize = 128 + DSIZE;
-    if (size == 448)
-        asize = 512 + DSIZE;
-
-    /* Search the free list for a fit */
-    if ((bp = find_fit_segregated(asize)) != NULL) {
-        place(bp, asize);
-        return bp;
+/*
+ * slab_free - give a slab object back to its run in arena a (locked); a run that becomes empty is given back to the
+ * heap
+ */
+static void slab_free(arena_t *a, void *bp) {
+    run_t *r = RUN_OF(bp);
+    int i = ((char *) bp - ((char *) r + sizeof(run_t))) / r->size;
+
+    r->map[i / 64] |= 1UL << (i % 64);
+
+    if (r->nfree++ == 0) {                                              //was full: back on the class list
+        r->prev = NULL;
+        r->next = a->runs[r->cls];
+        if (r->next != NULL)
+            r->next->prev = r;
+        a->runs[r->cls] = r;
     }
+    if (r->nfree == r->nobj)
+        run_destroy(a, r);
+}
 
-    /* No fit found. Get more memory and place the block */
-    extendsize = MAX(asize, CHONKSIZE);
-    if ((bp = extend_heap(extendsize / WSIZE)) == NULL)
+/*
+ * run_create - carve a new run for slab class cls out of arena a's heap and put it on the class list
+ */
+static run_t *run_create(arena_t *a, int cls) {
+    run_t *r;
+    unsigned long page;
+
+    if (a->heap_listp == 0 && arena_init(a) < 0)                       //the class may have been switched on elsewhere
+        return NULL;
+    if ((r = malloc_aligned(a, RUN_SIZE, RUN_SIZE)) == NULL)
         return NULL;
 
-    place(bp, asize);
+    page = ((char *) r - a->base) / RUN_SIZE;
+    __atomic_fetch_or(&a->run_map[page / 64], 1UL << (page % 64), __ATOMIC_RELAXED);
+
+    r->size = slab_size[cls];
+    r->cls = cls;
+    r->nobj = r->nfree = (RUN_SIZE - WSIZE - sizeof(run_t)) / r->size;        //next block's header ends the page
+    memset(r->map, 0, sizeof(r->map));
+    for (int i = 0; i < r->nobj; i++)
+        r->map[i / 64] |= 1UL << (i % 64);
+
+    r->prev = NULL;
+    r->next = a->runs[cls];
+    if (r->next != NULL)
+        r->next->prev = r;
+    a->runs[cls] = r;
+    return r;
+}
 
-    return bp;
+/*
+ * run_destroy - take an empty run off its class list and give it back to the heap of arena a
+ */
+static void run_destroy(arena_t *a, run_t *r) {
+    unsigned long page = ((char *) r - a->base) / RUN_SIZE;
+
+    if (r->prev != NULL)
+        r->prev->next = r->next;
+    else
+        a->runs[r->cls] = r->next;
+    if (r->next != NULL)
+        r->next->prev = r->prev;
+
+    __atomic_fetch_and(&a->run_map[page / 64], ~(1UL << (page % 64)), __ATOMIC_RELAXED);
+    free_block(a, r);
 }
 
 /*
-* mm_free - Free a block
-*/
-void mm_free(void *bp) {
+ * mm_realloc - Resize a block, in place whenever possible:
+ *   shrinking keeps the block and hands the tail back to the free lists,
+ *   growing absorbs the next block if it is free, and if the block (plus a free next block) is the last one
+ *   in the heap the heap is extended behind it. Otherwise a free previous block is absorbed (payload slides down),
+ *   and only if none of that works the payload is copied to a new block at the end of the heap (or, if it is large,
+ *   to a mapping). Mapped blocks are resized with their mapping.
+ */
+void *mm_realloc(void *ptr, size_t size) {
+    size_t osize = 0;
+    arena_t *a;
+    void *newptr;
+
+    if (ptr == NULL)
+        return mm_malloc(size);
+    if (size == 0) {
+        mm_free(ptr);
+        return NULL;
+    }
+    if (IS_MAPPED(ptr))
+        return realloc_mapped(ptr, size);
+
+    a = opt_threads ? arena_of(ptr) : &arenas[0];               //the block is resized within the arena it belongs to
+    if (is_slab(a, ptr)) {
+        osize = RUN_OF(ptr)->size;
+        if (size <= osize) {                                    //shrinking: move only to a smaller class
+            if (SLAB_CLASS(size) == RUN_OF(ptr)->cls)
+                return ptr;
+            newptr = mm_malloc(size);
+        } else {                                                //growing: likely to grow again, take a block with
+            arena_t *b = opt_threads ? thread_arena() : a;      //boundary tags that can grow in place
+            arena_t *first = b, *c;
+            if (WANTS_MAPPING(size)) {
+                newptr = malloc_mapped(size, DSIZE);
+            } else {
+                round_request(size, 1);
+                if (opt_threads)
+                    pthread_mutex_lock(&b->lock);
+                newptr = malloc_block(b, adjust_size(size));
+                while (newptr == NULL && opt_threads && (c = arena_spill(first, b)) != NULL) {
+                    b = c;
+                    newptr = malloc_block(b, adjust_size(size));
+                }
+                if (size <= SLAB_MAX && newptr != NULL)
+                    slab_count(newptr, 1);                      //as malloc_request does, free_tagged uncounts it
+                if (newptr != NULL)
+                    round_mark(b, newptr, size, size);
+                if (opt_threads)
+                    pthread_mutex_unlock(&b->lock);
+            }
+        }
+        if (newptr == NULL)
+            return NULL;
+        memcpy(newptr, ptr, MIN(size, osize));
+        mm_free(ptr);
+        return newptr;
+    }
 
-    // printf("Freeing block: ");
-    // printblock(bp);
+    if (opt_threads)
+        pthread_mutex_lock(&a->lock);
+    slab_count(ptr, -1);                                        //counted again at the size it ends up with
+    round_free(a, ptr);                                         //a free of the old request, a new one follows
+    newptr = realloc_block(a, ptr, size);
+    if (newptr == NULL) {
+        slab_count(ptr, 1);
+        osize = GET_SIZE(HDRP(ptr)) - WSIZE;                    //under the lock: neighbours update the header
+    } else if (!IS_MAPPED(newptr)) {
+        slab_count(newptr, 1);
+        round_request(size, 1);
+        round_mark(a, newptr, size, size);
+    }
+    if (opt_threads)
+        pthread_mutex_unlock(&a->lock);
+    if (newptr == NULL && opt_threads && (newptr = mm_malloc(size)) != NULL) {     //the arena is full: move to another one
+        memcpy(newptr, ptr, MIN(size, osize));
+        mm_free(ptr);
+    }
+    return newptr;
+}
 
-    if (bp == 0)
-        return;
+/*
+ * realloc_block - mm_realloc within ptr's arena a (locked) for a non-NULL ptr and a non-zero size
+ */
+static void *realloc_block(arena_t *a, void *ptr, size_t size) {
+    size_t asize, csize, nsize, psize, lsize;
+    char *next, *prev, *last;
+    void *newptr;
+
+    if (size > MAX_HEAP)                                                    //can't be in a heap
+        return move_to_mapping(a, ptr, size);
+    asize = adjust_size(size);
+    csize = GET_SIZE(HDRP(ptr));
+
+    /* Shrink (or no change): split off the tail if it is big enough to be a block of its own */
+    if (asize <= csize) {
+        shrink_block(a, ptr, asize);
+        return ptr;
+    }
 
-    size_t size = GET_SIZE(HDRP(bp));
-    if (heap_listp == 0) {
-        mm_init();
+    /* Grow: the next block is either free, the epilogue (size 0) or allocated */
+    next = NEXT_BLKP(ptr);
+    nsize = GET_SIZE(HDRP(next));
+    if (!GET_ALLOC(HDRP(next)) || nsize == 0) {
+
+        //next block is the end of the heap or a free block right before it: move the epilogue just far enough
+        if (csize + nsize < asize && (nsize == 0 || GET_SIZE(HDRP(NEXT_BLKP(next))) == 0)) {
+            if (extend_heap(a, MAX(asize - csize - nsize, MIN_SIZE) / WSIZE) == NULL)
+                return NULL;
+            nsize = GET_SIZE(HDRP(next));                                   //extend_heap coalesced the new space into next
+        }
+
+        if (csize + nsize >= asize) {
+            remove_block_from_list(a, (unsigned long *) next);
+            PUT(HDRP(ptr), PACK(csize + nsize, GET_PREV_ALLOC(HDRP(ptr)) | 1));
+            SET_PREV_ALLOC(HDRP(NEXT_BLKP(ptr)));
+            shrink_block(a, ptr, asize);
+            return ptr;
+        }
     }
 
-    PUT(HDRP(bp), PACK(size, 0));
-    PUT(FTRP(bp), PACK(size, 0));
-    coalesce(bp);
+    /* A free previous block (together with a free next block) may still be big enough: slide the payload down */
+    if (!GET_PREV_ALLOC(HDRP(ptr))) {
+        prev = PREV_BLKP(ptr);
+        psize = GET_SIZE(HDRP(prev));
+        if (GET_ALLOC(HDRP(next)))
+            nsize = 0;
+        if (psize + csize + nsize >= asize) {
+            remove_block_from_list(a, (unsigned long *) prev);
+            if (nsize)
+                remove_block_from_list(a, (unsigned long *) next);
+            memmove(prev, ptr, MIN(size, csize - WSIZE));
+            PUT(HDRP(prev), PACK(psize + csize + nsize, GET_PREV_ALLOC(HDRP(prev)) | 1));
+            SET_PREV_ALLOC(HDRP(NEXT_BLKP(prev)));
+            shrink_block(a, prev, asize);
+            return prev;
+        }
+    }
+
+    /* No room around the block: a large block moves to a mapping of its own, which can be resized without copying */
+    if (WANTS_MAPPING(size))
+        return move_to_mapping(a, ptr, size);
+
+    /* Otherwise move it. A block that is grown once tends to be grown again, so it goes to a free block with as much
+     * room again behind it, left free for the next realloc to grow into, or to a free last block big enough, which the
+     * next realloc can extend in place. Else it takes any free block that fits, as mm_malloc would: the heap grows
+     * (at its end, absorbing a free last block) only if there is none */
+    if ((newptr = find_fit_segregated(a, 2 * asize)) == NULL) {
+        last = (char *) mem_arena_hi(a->id) + 1;                            //epilogue
+        lsize = GET_PREV_ALLOC(HDRP(last)) ? 0 : GET_SIZE(HDRP(PREV_BLKP(last)));
+        if (lsize >= asize)
+            newptr = PREV_BLKP(last);
+        else if ((newptr = find_fit_segregated(a, asize)) == NULL &&
+                 (newptr = extend_heap(a, MAX(asize - lsize, MIN_SIZE) / WSIZE)) == NULL)
+            return NULL;
+    }
+    place(a, newptr, asize);
+    memcpy(newptr, ptr, MIN(size, csize - WSIZE));
+    free_block(a, ptr);
+    return newptr;
 }
 
 /*
  * remove_block_from_list - using the next and previous pointer stored in the free block, removes a block from any free list
  */
-static void remove_block_from_list(unsigned long *bp) {
+static void remove_block_from_list(arena_t *a, unsigned long *bp) {
 
     //check_segregated();
     //printf("\nBeginning of remove_block: %p\n", bp);
@@ -291,11 +1921,18 @@ static void remove_block_from_list(unsigned long *bp) {
 
     int num = which_list(bp);
 
+    a->stats.list_blocks[num]--;
+    a->stats.list_bytes[num] -= GET_SIZE(HDRP(bp));
+
     //update previous block in list: make it point to the block that bp is currently pointing to
     if (GET_PREVIOUS(bp) != NULL)
         PUT_POINTER((GET_PREVIOUS(bp)), GET_NEXT(bp));
-    else
-        GET_LIST(num) = (typeof(GET_LIST(num))) GET_NEXT(bp);
+    else if ((GET_LIST(a, num) = (typeof(GET_LIST(a, num))) GET_NEXT(bp)) == NULL) {
+        //list is empty now: clear its bit, and the bit of its first level class if that is empty as well
+        a->sl_bitmap[num >> SL_LOG2] &= ~(1u << (num & (SL_COUNT - 1)));
+        if (a->sl_bitmap[num >> SL_LOG2] == 0)
+            a->fl_bitmap &= ~(1u << (num >> SL_LOG2));
+    }
 
     //update next block in list: make its previous reference not point to bp, but to the block before bp (stored in bp's previous pointer)
     if (GET_NEXT(bp) != NULL)
@@ -306,29 +1943,57 @@ static void remove_block_from_list(unsigned long *bp) {
 }
 
 /*
- * add_to_free_list - adds a block to the beginning of a free list
+ * add_to_free_list - adds a block to the beginning of a free list, or at its place by address with the address
+ * ordered policy
  */
-static void add_to_free_list(unsigned long **bp) {
+static void add_to_free_list(arena_t *a, unsigned long **bp) {
 
     //printf("\nBeginning of add_to_free_list: %p\n", bp);
     //check_free_list();
 
     int num = which_list((void *) bp);
 
+    a->stats.list_blocks[num]++;
+    a->stats.list_bytes[num] += GET_SIZE(HDRP(bp));
+
+    if (opt_policy == MM_POLICY_ADDRESS) {
+        unsigned long **prev = NULL;
+        unsigned long **next = (typeof(next)) GET_LIST(a, num);
+
+        while (next != NULL && next < bp) {                                     //walk to the first block above bp
+            prev = next;
+            next = (typeof(next)) GET_NEXT(next);
+        }
+        GET_PREVIOUS(bp) = (unsigned long *) prev;
+        GET_NEXT(bp) = (unsigned long *) next;
+        if (prev != NULL)
+            GET_NEXT(prev) = (unsigned long *) bp;
+        else
+            GET_LIST(a, num) = (unsigned long *) bp;
+        if (next != NULL)
+            GET_PREVIOUS(next) = (unsigned long *) bp;
+
+        a->sl_bitmap[num >> SL_LOG2] |= 1u << (num & (SL_COUNT - 1));
+        a->fl_bitmap |= 1u << (num >> SL_LOG2);
+        return;
+    }
+
     //set the previous pointer of our free block to null
     PUT_POINTER(GO_PREVIOUS(bp), NULL);
 
     //set next pointer of new free block to current head of free list (old first block in list, to be second in list); set previous pointer of old first block in list to bp
-    if (GET_LIST(num) != NULL) {
-        PUT_POINTER(GO_NEXT(bp), GET_LIST(num));
-        PUT_POINTER(GO_PREVIOUS(GET_LIST(num)), bp);
+    if (GET_LIST(a, num) != NULL) {
+        PUT_POINTER(GO_NEXT(bp), GET_LIST(a, num));
+        PUT_POINTER(GO_PREVIOUS(GET_LIST(a, num)), bp);
     } else {
         //if the list is empty, make bp end of the list
         PUT_POINTER(GO_NEXT(bp), NULL);
+        a->sl_bitmap[num >> SL_LOG2] |= 1u << (num & (SL_COUNT - 1));
+        a->fl_bitmap |= 1u << (num >> SL_LOG2);
     }
 
     //set head of free list to new free block;
-    GET_LIST(num) = bp;
+    GET_LIST(a, num) = bp;
 
     //check_free_list();
     //printf("End of add_to_free_list: %p\n\n", bp);
@@ -337,48 +2002,51 @@ static void add_to_free_list(unsigned long **bp) {
 /*
  * coalesce - Boundary tag coalescing. Return ptr to coalesced block
  */
-static void *coalesce(void *bp) {
-    size_t prev_alloc = GET_ALLOC(FTRP(PREV_BLKP(bp)));
+static void *coalesce(arena_t *a, void *bp) {
+    size_t prev_alloc = GET_PREV_ALLOC(HDRP(bp));
     size_t next_alloc = GET_ALLOC(HDRP(NEXT_BLKP(bp)));
     size_t size = GET_SIZE(HDRP(bp));
+    PROF_BEGIN(t);
 
     //when coalescing is performed, the old instances need to be removed from their free lists
     if (!prev_alloc) {
         //remove prev
-        remove_block_from_list((unsigned long *) PREV_BLKP(bp));
+        remove_block_from_list(a, (unsigned long *) PREV_BLKP(bp));
     }
 
     if (!next_alloc) {
         //remove next
-        remove_block_from_list((unsigned long *) NEXT_BLKP(bp));
+        remove_block_from_list(a, (unsigned long *) NEXT_BLKP(bp));
     }
 
-    //no coalescing; add new free block to the respective list
+    //no coalescing: the block goes to its list as it is
     if (prev_alloc && next_alloc) {              /* Case 1 */
-        add_to_free_list(bp);
-        return bp;
 
     } else if (prev_alloc && !next_alloc) {      /* Case 2 */
+        a->stats.coalesces++;
         size += GET_SIZE(HDRP(NEXT_BLKP(bp)));
-        PUT(HDRP(bp), PACK(size, 0));
+        PUT(HDRP(bp), PACK(size, PREV_ALLOC));
         PUT(FTRP(bp), PACK(size, 0));
 
     } else if (!prev_alloc && next_alloc) {      /* Case 3 */
+        a->stats.coalesces++;
         size += GET_SIZE(HDRP(PREV_BLKP(bp)));
         PUT(FTRP(bp), PACK(size, 0));
-        PUT(HDRP(PREV_BLKP(bp)), PACK(size, 0));
+        PUT(HDRP(PREV_BLKP(bp)), PACK(size, GET_PREV_ALLOC(HDRP(PREV_BLKP(bp)))));
         bp = PREV_BLKP(bp);
 
     } else {                                     /* Case 4 */
+        a->stats.coalesces += 2;
         size += GET_SIZE(HDRP(PREV_BLKP(bp))) +
                 GET_SIZE(FTRP(NEXT_BLKP(bp)));
-        PUT(HDRP(PREV_BLKP(bp)), PACK(size, 0));
+        PUT(HDRP(PREV_BLKP(bp)), PACK(size, GET_PREV_ALLOC(HDRP(PREV_BLKP(bp)))));
         PUT(FTRP(NEXT_BLKP(bp)), PACK(size, 0));
         bp = PREV_BLKP(bp);
     }
 
     // Once we have the new coalesced block, it gets placed as the head of the respective free list
-    add_to_free_list(bp);
+    add_to_free_list(a, bp);
+    PROF_END(MM_PROF_COALESCE, t);
     return bp;
 }
 
@@ -388,81 +2056,131 @@ static void *coalesce(void *bp) {
 //// Helper functions we added
 
 /*
- * find_fit_segregated - find a fitting block, starting in the list fitting the size we are looking for
+ * adjust_size - block size needed for a payload of size bytes: include overhead and keep alignment, never below MIN_SIZE
  */
-static void *find_fit_segregated(size_t asize) {
-    int num = which_list_asize(asize);
-    // first fit seg list
-    unsigned long **bp = NULL;
-    for (num; num <
-              number_of_lists; num++) {                                       //outer loop; start in list of which_list_asize(asize), and move to lists containing larger blocks if no fit found
-        bp = GET_LIST(num);
-        for (bp; GO_NEXT(bp) != NULL; bp = (typeof(bp)) GET_NEXT(
-                bp)) {            //inner loop: search a list from beginning to ending
-            if ((asize <= GET_SIZE(HDRP(bp)))) {
-                // error statement when block is taken
-
-                return bp;
-            }
-        }
-    }
-    return NULL;                                                                    //no fit found in ANY list
+static size_t adjust_size(size_t size) {
+    if (size <= MIN_SIZE - WSIZE)   //Group 79: size <= 20 bytes
+        return MIN_SIZE;            //Group 79: asize = 24 bytes
+    return DSIZE * ((size + (WSIZE) + (DSIZE - 1)) / DSIZE);    //header only, allocated blocks have no footer
 }
 
 /*
- * which_list - helper function to calculate a free blocks designated list based on the size
+ * shrink_block - cut the allocated block bp down to asize bytes; the tail becomes a free block (merged with a free
+ * right neighbour) if it is at least MIN_SIZE, otherwise the block keeps its size
  */
-static int which_list(void *bp) {
-    return which_list_asize(GET_SIZE(HDRP(bp)));
+static void shrink_block(arena_t *a, void *bp, size_t asize) {
+    size_t csize = GET_SIZE(HDRP(bp));
+    char *rest;
+
+    if ((csize - asize) < MIN_SIZE)
+        return;
+
+    PUT(HDRP(bp), PACK(asize, GET_PREV_ALLOC(HDRP(bp)) | 1));
+    rest = NEXT_BLKP(bp);
+    a->stats.splits++;
+    PUT(HDRP(rest), PACK(csize - asize, PREV_ALLOC));
+    PUT(FTRP(rest), PACK(csize - asize, 0));
+    CLEAR_PREV_ALLOC(HDRP(NEXT_BLKP(rest)));
+    coalesce(a, rest);
 }
 
 /*
- * which_list_asize - uses bit shifting in combination with a counter variable to calculate most significant bit of the size information, determining the list to put the block in/take a block from
- * buckets are defined by the powers of 2: bucket zero < 64<= bucket one < 128<= bucket three <256 <=...
+ * find_fit_segregated - find a fitting block in constant time: blocks in the class of asize itself may be smaller than
+ * asize, so only the first FIT_SCAN of them are tried, then the head of the next non-empty class is taken, which
+ * always fits. With address ordered lists that is the lowest block of the class.
  */
-static int which_list_asize(int size) {
-    size = size >> 6;                               //all blocks that have no bit more significant than the sixth (representing size < 63) go into the first list (offset = 0);
-    int offset = 0;
-    while (size != 0) {                             //for every other significant bit, move on list further down
-        size = size >> 1;
-        offset++;
+static void *find_fit_segregated(arena_t *a, size_t asize) {
+    int num = which_list_asize(asize);
+    unsigned long **bp = (typeof(bp)) GET_LIST(a, num);
+
+    a->stats.searches++;
+    if (opt_policy == MM_POLICY_BEST_FIT)
+        return find_best_fit(a, asize, num);
+
+    for (int n = 0; bp != NULL && n < FIT_SCAN; bp = (typeof(bp)) GET_NEXT(bp), n++) {  //first fit in the own class
+        a->stats.search_steps++;
+        if (asize <= GET_SIZE(HDRP(bp)))
+            return bp;
     }
-    if (offset > number_of_lists - 1)               //catch possible overflow
-        offset = number_of_lists - 1;
-    return offset;
+
+    if ((num = next_list(a, num + 1)) < 0)
+        return NULL;                                                                //no fit found in ANY list
+    return GET_LIST(a, num);
 }
 
+/*
+ * find_best_fit - bounded best fit: the smallest fitting block among the first opt_best_fit_k blocks of the class of
+ * asize (list num), if none of them fits among the first opt_best_fit_k blocks of the next non-empty class
+ */
+static void *find_best_fit(arena_t *a, size_t asize, int num) {
+    unsigned long **bp, **best = NULL;
+    size_t size, best_size = 0;
+
+    for (int pass = 0; pass < 2 && num >= 0; pass++, num = next_list(a, num + 1)) {
+        bp = (typeof(bp)) GET_LIST(a, num);
+        for (int n = 0; bp != NULL && n < opt_best_fit_k; bp = (typeof(bp)) GET_NEXT(bp), n++) {
+            a->stats.search_steps++;
+            size = GET_SIZE(HDRP(bp));
+            if (size >= asize && (best == NULL || size < best_size)) {
+                best = bp;
+                best_size = size;
+                if (size == asize)                                                  //can't do better
+                    return best;
+            }
+        }
+        if (best != NULL)
+            return best;
+    }
+    return NULL;
+}
 
 /*
- * ALTERNATIVE FUNCTIONS to find bucket introducing more sophisticated system of taking into account more than just one bit but a chosen number; not used because buckets of smaller range don't seem to increase util any further and it runs a bit slower than which_list_asize
+ * next_list - first non-empty list at or above list num, -1 if there is none; one bitmap lookup per level
  */
-static int which_list_asize_alternative(int size) {
-    size = size >> 6;                               //all blocks that have no bit more significant than the sixth (representing size < 63) go into the first list (offset = 0;
-    int bucket = 0;
-    int dep =1;                                     //depth chosen, representing how many additional bits of the size should be taken into account whn choosing a list
-    int offset = depth(dep, size);
-   while(offset==-1){                               //while -1, size is still too big, meaning it still doesnt fit a list.
-       size=size>>1;
-       bucket = bucket + ((1<<dep));
-       offset = depth(dep, size);
+static int next_list(arena_t *a, int num) {
+    int fl = num >> SL_LOG2;
+    unsigned int map;
+
+    if (num >= number_of_lists)
+        return -1;
+
+    map = a->sl_bitmap[fl] & (~0u << (num & (SL_COUNT - 1)));     //larger second level classes in the same first level
+    if (map == 0) {
+        map = a->fl_bitmap & (~0u << (fl + 1));                    //otherwise any list of the next non-empty first level
+        if (map == 0)
+            return -1;
+        fl = __builtin_ctz(map);
+        map = a->sl_bitmap[fl];
     }
-    bucket +=offset;
-    if (bucket > number_of_lists - 1)               //catch possible overflow
-        bucket = number_of_lists - 1;
+    return (fl << SL_LOG2) + __builtin_ctz(map);
+}
 
-    return bucket;
+/*
+ * which_list - helper function to calculate a free blocks designated list based on the size
+ */
+static int which_list(void *bp) {
+    return which_list_asize(GET_SIZE(HDRP(bp)));
 }
 
 /*
- * helper function using a variable depth (representing a power of 2) to split over 2^depth buckets.
+ * which_list_asize - list of a size class, without loops: the first level is the most significant bit of the size
+ * (all sizes < 64 in first level 0), the second level the SL_LOG2 bits below it (for sizes < 64: size / 16)
  */
-static int depth(int depth, int size) {
-    depth = (1<<depth)-1;
-    for(int i = 0; i<=depth; i++){
-        if(size == i)
-            return i;
+static int which_list_asize(size_t size) {
+    int fl, sl;
+
+    if (size < (1 << FL_SHIFT)) {
+        fl = 0;
+        sl = size >> (FL_SHIFT - SL_LOG2);
+    } else {
+        fl = MSB(size) - FL_SHIFT + 1;
+        sl = (size >> (MSB(size) - SL_LOG2)) & (SL_COUNT - 1);
+        if (fl > FL_COUNT - 1) {                    //catch possible overflow
+            fl = FL_COUNT - 1;
+            sl = SL_COUNT - 1;
+        }
     }
-    return -1;
+    return (fl << SL_LOG2) + sl;
 }
 
 
@@ -473,53 +2191,57 @@ static int depth(int depth, int size) {
 /*
  * extend_heap - Extend heap with free block and return its block pointer
  */
-static void *extend_heap(size_t words) {
+static void *extend_heap(arena_t *a, size_t words) {
     char *bp;
     size_t size;
+    PROF_BEGIN(t);
 
     /* Allocate an even number of words to maintain alignment */
     size = (words % 2) ? (words + 1) * WSIZE : words * WSIZE;
-    if ((long) (bp = mem_sbrk(size)) == -1)
+    if ((long) (bp = mem_arena_sbrk(a->id, size)) == -1)
         return NULL;
+    a->stats.extends++;
 
     /* Initialize free block header/footer and the epilogue header */
-    PUT(HDRP(bp), PACK(size, 0));         /* Free block header */
+    PUT(HDRP(bp), PACK(size, GET_PREV_ALLOC(HDRP(bp))));  /* Free block header, over the old epilogue */
     PUT(FTRP(bp), PACK(size, 0));         /* Free block footer */
-    PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 1)); /* New epilogue header */
+    PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 1)); /* New epilogue header, previous block is free */
 
 
     /* Coalesce if the previous block was free */
-    return coalesce(bp);
+    bp = coalesce(a, bp);
+    PROF_END(MM_PROF_EXTEND, t);
+    return bp;
 }
 
 /*
  * place - Place block of asize bytes at start of free block bp and split if remainder would be at least minimum block size
  */
-static void place(void *bp, size_t asize) {
+static void place(arena_t *a, void *bp, size_t asize) {
     size_t csize = GET_SIZE(HDRP(bp));
-    remove_block_from_list(bp);                                    //remove chosen block from its list
+    remove_block_from_list(a, bp);                                    //remove chosen block from its list
     if ((csize - asize) >= MIN_SIZE) {
-        PUT(HDRP(bp), PACK(asize, 1));
-        PUT(FTRP(bp), PACK(asize, 1));
+        PUT(HDRP(bp), PACK(asize, GET_PREV_ALLOC(HDRP(bp)) | 1));
         bp = NEXT_BLKP(bp);
-        PUT(HDRP(bp), PACK(csize - asize, 0));
+        a->stats.splits++;
+        PUT(HDRP(bp), PACK(csize - asize, PREV_ALLOC));
         PUT(FTRP(bp), PACK(csize - asize, 0));
-        add_to_free_list(
+        add_to_free_list(a,
                 (unsigned long **) bp);                             //add the new small block (residue from chosen block) to the respecive list
     } else {
-        PUT(HDRP(bp), PACK(csize, 1));
-        PUT(FTRP(bp), PACK(csize, 1));
+        PUT(HDRP(bp), PACK(csize, GET_PREV_ALLOC(HDRP(bp)) | 1));
+        SET_PREV_ALLOC(HDRP(NEXT_BLKP(bp)));
     }
 }
 
 /*
  *find_fit - UNUSED - Find a fit for a block with asize bytes
 */
-static void *find_fit(size_t asize) {
+static void *find_fit(arena_t *a, size_t asize) {
     /* First fit search */
     void *bp;
 
-    for (bp = heap_listp; GET_SIZE(HDRP(bp)) > 0; bp = NEXT_BLKP(bp)) {
+    for (bp = a->heap_listp; GET_SIZE(HDRP(bp)) > 0; bp = NEXT_BLKP(bp)) {
         if (!GET_ALLOC(HDRP(bp)) && (asize <= GET_SIZE(HDRP(bp)))) {
             //here was the remove_block but we will move it to place()
             return bp;
@@ -537,17 +2259,17 @@ static void *find_fit(size_t asize) {
 /*
  * used to move through a free list checking all necessary information about the blocks contained
  */
-static void check_free_list() {
+static void check_free_list(arena_t *a) {
 
     int list = 0;
     for (; list < number_of_lists; list++) {
         printf("==============================\n");
         printf("FREE LIST CHECK START:\n");
 
-        unsigned long **fp = GET_LIST(list);
+        unsigned long **fp = GET_LIST(a, list);
 
         printf("------------------------------\n");
-        printf("List No. %d Head: %p\n", list, GET_LIST(list));
+        printf("List No. %d Head: %p\n", list, GET_LIST(a, list));
         printf("------------------------------\n");
 
         for (fp; fp != NULL; fp = GET_NEXT(fp)) {
@@ -571,7 +2293,7 @@ static void check_free_list() {
                 printf("Double-Word aligned: \tTrue.\n");
             }
 
-            if (GET(HDRP(fp)) != GET(FTRP(fp))) {
+            if (GET_SIZE(HDRP(fp)) != GET_SIZE(FTRP(fp))) {
                 printf("Error: header does not match footer\n");
             } else {
                 printf("Header matches footer: \tTrue.\n");
@@ -595,18 +2317,17 @@ static void check_free_list() {
 /*
  * check_segregated - used to check headers of all lists
  */
-static void check_segregated() {
-    printf("\n\nseg_list_head:\t\t\t%p\n", seg_list_head);
-    printf("check (expected: ???):\t%zu\n", (size_t) *seg_list_head);
-    printf("one word above seg_list_head (expected: 0): %d\n", *(unsigned int *) (((char *) seg_list_head) - WSIZE));
+static void check_segregated(arena_t *a) {
+    printf("\n\nseg_list_head:\t\t\t%p\n", a->seg_list_head);
+    printf("check (expected: ???):\t%zu\n", (size_t) *a->seg_list_head);
     printf("SIZE_OF_SEG_STORAGE:\t%zu\n", SIZE_OF_SEG_STORAGE);
-    printf("heap_listp:\t\t\t\t%p\n", (void *) heap_listp);
-    printf("check (expected: 9):\t%d\n\n", *heap_listp);
+    printf("heap_listp:\t\t\t\t%p\n", (void *) a->heap_listp);
+    printf("check (expected: 9):\t%d\n\n", *a->heap_listp);
 
 
     for (int i = 0; i < number_of_lists; i++) {
-        printf("seg_list_head with offset %d: %p\n", i, GO_LIST(i));
-        printf("\t\tvalue found at %d: %p\n", i, GET_LIST(i));
+        printf("seg_list_head with offset %d: %p\n", i, GO_LIST(a, i));
+        printf("\t\tvalue found at %d: %p\n", i, GET_LIST(a, i));
     }
 
     printf("\n");
@@ -616,26 +2337,45 @@ static void check_segregated() {
  * checkheap - Minimal check of the heap for consistency
  */
 void checkheap(int verbose) {
-    char *bp = heap_listp;
+    char *bp;
 
-    if (verbose)
-        printf("Heap (%p):\n", (void *) heap_listp);
+    for (int i = 0; i < MAX_ARENAS; i++) {                     //every arena that has been set up is a heap of its own
+        char *heap_listp = arenas[i].heap_listp;
+        if (heap_listp == 0)
+            continue;
 
-    if ((GET_SIZE(HDRP(heap_listp)) != DSIZE) || !GET_ALLOC(HDRP(heap_listp)))
-        printf("Bad prologue header\n");
-    checkblock(heap_listp);
+        if (verbose)
+            printf("Heap %d (%p):\n", i, (void *) heap_listp);
+
+        if ((GET_SIZE(HDRP(heap_listp)) != DSIZE) || !GET_ALLOC(HDRP(heap_listp)))
+            printf("Bad prologue header\n");
+        checkblock(heap_listp);
+
+        for (bp = heap_listp; GET_SIZE(HDRP(bp)) > 0; bp = NEXT_BLKP(bp)) {
+            if (verbose)
+                printblock(bp);
+            checkblock(bp);
+            if (!GET_PREV_ALLOC(HDRP(NEXT_BLKP(bp))) != !GET_ALLOC(HDRP(bp)))
+                printf("Error: prev-alloc bit of %p does not match %p\n", NEXT_BLKP(bp), bp);
+        }
 
-    for (bp = heap_listp; GET_SIZE(HDRP(bp)) > 0; bp = NEXT_BLKP(bp)) {
         if (verbose)
             printblock(bp);
-        checkblock(bp);
+        if ((GET_SIZE(HDRP(bp)) != 0) || !(GET_ALLOC(HDRP(bp))))
+            printf("Bad epilogue header\n");
+
+        for (int num = 0; num < number_of_lists; num++) {      //the statistics must match the free lists
+            size_t blocks = 0, bytes = 0;
+            for (bp = (char *) GET_LIST(&arenas[i], num); bp != NULL; bp = (char *) GET_NEXT(bp)) {
+                blocks++;
+                bytes += GET_SIZE(HDRP(bp));
+            }
+            if (blocks != arenas[i].stats.list_blocks[num] || bytes != arenas[i].stats.list_bytes[num])
+                printf("Error: list %d holds %zu blocks of %zu bytes, the statistics say %zu of %zu\n", num, blocks,
+                       bytes, arenas[i].stats.list_blocks[num], arenas[i].stats.list_bytes[num]);
+        }
     }
 
-    if (verbose)
-        printblock(bp);
-    if ((GET_SIZE(HDRP(bp)) != 0) || !(GET_ALLOC(HDRP(bp))))
-        printf("Bad epilogue header\n");
-
     /*
      * additional checkheap() functionality we implemented, but didnt want to use all the time
      */
@@ -662,7 +2402,7 @@ void checkheap(int verbose) {
 }
 
 /*
- *  printblock - no changes made
+ *  printblock - prints header and, for free blocks, footer
  */
 static void printblock(void *bp) {
     size_t hsize, halloc, fsize, falloc;
@@ -670,28 +2410,34 @@ static void printblock(void *bp) {
     checkheap(0);
     hsize = GET_SIZE(HDRP(bp));
     halloc = GET_ALLOC(HDRP(bp));
-    fsize = GET_SIZE(FTRP(bp));
-    falloc = GET_ALLOC(FTRP(bp));
 
     if (hsize == 0) {
         printf("%p: EOL\n", bp);
         return;
     }
 
-    printf("%p: header: [%zu:%c] footer: [%zu:%c]\n", bp,
-           hsize, (halloc ? 'a' : 'f'),
+    if (halloc) {
+        printf("%p: header: [%zu:a%s]\n", bp,
+               hsize, (GET_PREV_ALLOC(HDRP(bp)) ? "" : " prev f"));
+        return;
+    }
+
+    fsize = GET_SIZE(FTRP(bp));
+    falloc = GET_ALLOC(FTRP(bp));
+    printf("%p: header: [%zu:f] footer: [%zu:%c]\n", bp,
+           hsize,
            fsize, (falloc ? 'a' : 'f'));
 }
 
 /*
-*  checkblock - no changes made
+*  checkblock - alignment, and free blocks' header matching their footer (allocated blocks have none)
 */
 static void checkblock(void *bp) {
     if ((size_t) bp % 8) {
         printf("Error: %p is not doubleword aligned\n", bp);
     }
 
-    if (GET(HDRP(bp)) != GET(FTRP(bp))) {
+    if (!GET_ALLOC(HDRP(bp)) && GET_SIZE(HDRP(bp)) != GET_SIZE(FTRP(bp))) {
         printf("Error: %p header does not match footer\n", bp);
     }
 }
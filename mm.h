@@ -5,11 +5,99 @@
 extern int mm_init (void);
 extern void *mm_malloc (size_t size);
 extern void mm_free (void *ptr);
+extern void mm_free_sized (void *ptr, size_t size); /* size as last requested */
+extern void *mm_realloc(void *ptr, size_t size);
+extern void *mm_memalign(size_t align, size_t size); /* align: a power of two */
+extern void *mm_calloc(size_t n, size_t size); /* zeroed, NULL if n * size overflows */
 
 /*
- * mm_realloc - You DO NOT need to implement this function
+ * mm_malloc_batch - Allocate count blocks of size bytes into out, returns
+ * how many it could allocate. mm_free_batch - Free n blocks at once, ptrs
+ * may hold NULLs and is reordered.
  */
-/* void *mm_realloc(void *ptr, size_t size) { return NULL;} */
+extern size_t mm_malloc_batch(size_t size, size_t count, void **out);
+extern void mm_free_batch(void **ptrs, size_t n);
+
+/*
+ * mm_get_stats - Fill st with a snapshot of the allocator's counters, summed
+ * over all arenas. The counters are kept up to date as the heap changes, so
+ * nothing is walked. The free lists are the size classes: list 4*f+s holds
+ * blocks from 16*s bytes for f = 0, from (4+s) << (f+3) bytes above.
+ */
+#define MM_STATS_LISTS 80
+
+typedef struct {
+    size_t heap_bytes;      /* heaps of all arenas, mappings not included */
+    size_t in_use_bytes;    /* heap bytes neither free nor deferred: blocks,
+                               slab runs, thread caches, heap metadata */
+    size_t free_bytes;      /* heap bytes in free blocks */
+    size_t deferred_bytes;  /* freed blocks waiting in quick bins */
+    size_t mapped_bytes;    /* blocks in mappings of their own */
+    size_t list_blocks[MM_STATS_LISTS]; /* free blocks on each list ... */
+    size_t list_bytes[MM_STATS_LISTS];  /* ... and their bytes */
+    /* events since mm_init */
+    unsigned long extends;      /* heap extensions */
+    unsigned long splits;       /* blocks split off a larger free one */
+    unsigned long coalesces;    /* free blocks merged with a free neighbour */
+    unsigned long searches;     /* free list searches for a fit ... */
+    unsigned long search_steps; /* ... and the free blocks they looked at */
+} mm_stats_t;
+
+extern void mm_get_stats(mm_stats_t *st);
+
+/*
+ * mm_get_profile - With mm.c compiled with MM_PROFILE defined, fill p with
+ * histograms since mm_init of the ticks (TSC cycles on x86, nanoseconds
+ * elsewhere) spent per call, and of the free blocks looked at per fit
+ * search, and return 1. Returns 0 otherwise. Bucket b counts the values
+ * from MM_PROF_LOW(b) on, four buckets per power of two.
+ */
+#define MM_PROF_MALLOC   0 /* mm_malloc */
+#define MM_PROF_FREE     1 /* mm_free */
+#define MM_PROF_COALESCE 2 /* boundary tag coalescing of a free block */
+#define MM_PROF_EXTEND   3 /* heap extension, its coalescing included */
+#define MM_PROF_SEARCH   4 /* free blocks per fit search, not ticks */
+#define MM_PROF_EVENTS   5
+#define MM_PROF_BUCKETS  256
+#define MM_PROF_LOW(b)   ((b) < 4 ? (unsigned long)(b) : (4UL + (b) % 4) << ((b) / 4 - 1))
+
+typedef struct {
+    unsigned long count[MM_PROF_EVENTS][MM_PROF_BUCKETS];
+} mm_profile_t;
+
+extern int mm_get_profile(mm_profile_t *p);
+
+/*
+ * mm_setopt - Set an allocator option, returns 1 on success and 0 for an
+ * unknown option or a value out of its range. Set options before calling
+ * mm_init. The thresholds are byte counts, up to LONG_MAX.
+ */
+#define MM_OPT_THREADS    1 /* nonzero: thread-safe heap with per-thread caches */
+#define MM_OPT_ARENAS     2 /* arenas threads are spread over, 0 = one per CPU */
+#define MM_OPT_ARENA_BIND 3 /* how a thread picks its arena, see below */
+
+#define MM_BIND_ROUND_ROBIN 0 /* on its first allocation, round-robin */
+#define MM_BIND_CPU         1 /* by the CPU it is running on, per call */
+
+#define MM_OPT_POLICY     4 /* placement policy for free blocks, see below */
+#define MM_OPT_BEST_FIT_K 5 /* free blocks best fit looks at per class, > 0 */
+
+#define MM_POLICY_FIRST_FIT 0 /* first block that fits (default) */
+#define MM_POLICY_BEST_FIT  1 /* smallest fit among K candidates */
+#define MM_POLICY_ADDRESS   2 /* first fit on free lists kept in address order */
+
+#define MM_OPT_TRIM_THRESHOLD    6 /* free bytes kept at the top of a heap, which shrinks at twice that, 0 = never */
+#define MM_OPT_RELEASE_THRESHOLD 7 /* free blocks this large give their pages back, 0 = never */
+#define MM_OPT_MMAP_THRESHOLD    8 /* requests this large get a mapping of their own, 0 = never */
+#define MM_OPT_DEFER             9 /* percent of a heap freed small blocks may hold before they are
+                                      coalesced, 0 = coalesce on every free (default) */
+#define MM_OPT_CHECK_SIZE       10 /* nonzero: mm_free_sized aborts when the size does not fit the block,
+                                      may be set at any time */
+#define MM_OPT_ROUND            11 /* percent a request may be rounded up to a size requested often, so that
+                                      blocks of both sizes are reused for each other, 0 = never (default 15) */
+#define MM_OPT_ROUND_KEEP       12 /* nonzero: what rounding learned outlives mm_init */
+
+extern int mm_setopt(int param, long value);
 
 /*
  * Students work in groups of one, two or three members. Groups
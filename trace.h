@@ -0,0 +1,53 @@
+/*
+ * trace.h - Binary trace format
+ *
+ * A binary trace holds the same requests as a .rep text trace (see
+ * traces/README), but as fixed-width records that mdriver maps into
+ * memory and replays in place, without parsing. The file is a
+ * trace_hdr_t followed by num_ops trace_rec_t, in the byte order of the
+ * machine that wrote it. mdriver -c converts a text trace.
+ *
+ * A capture log (capture.c) is CAPTURE_MAGIC followed by capture_rec_t
+ * records, in the order the threads of the captured program flushed
+ * them. mdriver sorts a log by the sequence numbers of its records when
+ * it reads it, and -c turns it into a binary trace as well.
+ */
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+#define TRACE_MAGIC "mmtrace1"    /* first 8 bytes of a binary trace */
+
+/* Request types of the records */
+#define TRACE_ALLOC   0           /* a and m lines */
+#define TRACE_FREE    1           /* f lines */
+#define TRACE_REALLOC 2           /* r lines */
+
+/* Header of a binary trace, the 4 header lines of a text trace */
+typedef struct {
+    char magic[8];                /* TRACE_MAGIC, not NUL terminated */
+    int32_t sugg_heapsize;        /* suggested heap size (unused) */
+    int32_t num_ids;              /* number of request ids */
+    int32_t num_ops;              /* number of records that follow */
+    int32_t weight;               /* weight for this trace (unused) */
+} trace_hdr_t;
+
+/* One request */
+typedef struct {
+    int32_t type;                 /* TRACE_ALLOC, TRACE_FREE or TRACE_REALLOC */
+    int32_t index;                /* request id, 0 .. num_ids-1 */
+    uint64_t size;                /* bytes requested, for a free the size of
+                                     the block it releases */
+    uint64_t align;               /* alignment of an m line, 0 otherwise */
+} trace_rec_t;
+
+#define CAPTURE_MAGIC "mmcapt01"  /* first 8 bytes of a capture log */
+
+/* One request of a capture log */
+typedef struct {
+    uint64_t seq;                 /* position of the request in the trace */
+    trace_rec_t rec;
+} capture_rec_t;
+
+#endif /* TRACE_H */